@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include "analysis.h"
+#include "huffman_util.h"
+
+// internal functions
+void* analysis_thread(void* arg);
+int propose_length(int* counts, int length, int ladder);
+
+// start analysis thread on input of <size> bytes
+Analysis* start_analysis(const char* data, size_t size, int max_chars, int ladder, int max_trie_nodes, Trie* trie) {
+
+    Analysis* analysis = (Analysis*)safe_malloc(sizeof(Analysis));
+    analysis->data = data;
+    analysis->size = size;
+    analysis->max_chars = max_chars;
+    analysis->ladder = ladder;
+    analysis->max_trie_nodes = max_trie_nodes;
+    analysis->trie = trie;
+    atomic_init(&analysis->head, 0);
+    atomic_init(&analysis->tail, 0);
+    atomic_init(&analysis->stop, 0);
+    atomic_init(&analysis->coder_waiting, 0);
+    atomic_init(&analysis->analysis_waiting, 0);
+    atomic_init(&analysis->coder_wake, 0);
+    atomic_init(&analysis->analysis_wake, 0);
+    pthread_mutex_init(&analysis->lock, NULL);
+    pthread_cond_init(&analysis->ready, NULL);
+    pthread_cond_init(&analysis->space, NULL);
+
+    if (pthread_create(&analysis->thread, NULL, analysis_thread, analysis)) {
+        fprintf(stderr, "[%s:%i] could not start analysis thread\n", __FILE__, __LINE__);
+        exit(1);
+    }
+    return analysis;
+}
+
+// count strings at every position of the input and publish a proposal for each position
+void* analysis_thread(void* arg) {
+    Analysis* analysis = (Analysis*)arg;
+
+    int counts[analysis->max_chars+1];
+
+    for (size_t pos = 0; pos < analysis->size; pos++) {
+
+        if (atomic_load_explicit(&analysis->stop, memory_order_relaxed)) return NULL;
+
+        // wait until the coder has used the proposal that will be overwritten
+        if (pos >= atomic_load_explicit(&analysis->tail, memory_order_acquire) + ANALYSIS_RING_SIZE) {
+            pthread_mutex_lock(&analysis->lock);
+            atomic_store(&analysis->analysis_wake, pos + ANALYSIS_BATCH - ANALYSIS_RING_SIZE);
+            atomic_store(&analysis->analysis_waiting, 1);
+            while (atomic_load(&analysis->tail) < atomic_load(&analysis->analysis_wake) && !atomic_load(&analysis->stop)) {
+                pthread_cond_wait(&analysis->space, &analysis->lock);
+            }
+            atomic_store(&analysis->analysis_waiting, 0);
+            pthread_mutex_unlock(&analysis->lock);
+            if (atomic_load_explicit(&analysis->stop, memory_order_relaxed)) return NULL;
+        }
+
+        if (analysis->trie->nodes >= analysis->max_trie_nodes) {
+            clear_trie(analysis->trie);
+        }
+
+        size_t left = analysis->size - pos;
+        int length = left < (size_t)analysis->max_chars ? (int)left : analysis->max_chars;
+        trie_increment_prefix_counts(analysis->trie, &analysis->data[pos], length, 1, counts);
+
+        analysis->ring[pos % ANALYSIS_RING_SIZE] = (unsigned char)propose_length(counts, length, analysis->ladder);
+        atomic_store(&analysis->head, pos + 1);
+        if (atomic_load(&analysis->coder_waiting) && pos + 1 >= atomic_load(&analysis->coder_wake)) {
+            pthread_mutex_lock(&analysis->lock);
+            pthread_cond_signal(&analysis->ready);
+            pthread_mutex_unlock(&analysis->lock);
+        }
+    }
+    return NULL;
+}
+
+// choose the length with the best count, times length to favor longer strings
+int propose_length(int* counts, int length, int ladder) {
+    int best_length = 1;
+    int best_count = 0;
+    for (int len = length; len > 0; len--) {
+        if (ladder && (len & (len-1))) continue;    // length is not a power of 2
+
+        if (counts[len]*len/2 > best_count) {
+            best_length = len;
+            best_count = counts[len]*len/2;
+        }
+    }
+    return best_length;
+}
+
+// get the proposed length of a new string at position pos, waits if the analysis thread is not there yet
+// positions must be asked in increasing order, proposals for earlier positions are dropped
+// each side sets its waiting flag before it checks the other position, and stores its own position
+// before it checks the flag of the other side, so one of them always sees the other and no wakeup is lost
+int analysis_proposal(Analysis* analysis, size_t pos) {
+    atomic_store(&analysis->tail, pos);
+    if (atomic_load(&analysis->analysis_waiting) && pos >= atomic_load(&analysis->analysis_wake)) {
+        pthread_mutex_lock(&analysis->lock);
+        pthread_cond_signal(&analysis->space);
+        pthread_mutex_unlock(&analysis->lock);
+    }
+    if (atomic_load_explicit(&analysis->head, memory_order_acquire) <= pos) {
+        size_t wake = pos + ANALYSIS_BATCH < analysis->size ? pos + ANALYSIS_BATCH : analysis->size;
+        pthread_mutex_lock(&analysis->lock);
+        atomic_store(&analysis->coder_wake, wake);
+        atomic_store(&analysis->coder_waiting, 1);
+        while (atomic_load(&analysis->head) < wake) {
+            pthread_cond_wait(&analysis->ready, &analysis->lock);
+        }
+        atomic_store(&analysis->coder_waiting, 0);
+        pthread_mutex_unlock(&analysis->lock);
+    }
+    return analysis->ring[pos % ANALYSIS_RING_SIZE];
+}
+
+// stop analysis thread and free analysis, the counting trie is not freed
+void stop_analysis(Analysis* analysis) {
+    if (!analysis) return;
+    pthread_mutex_lock(&analysis->lock);
+    atomic_store(&analysis->stop, 1);
+    pthread_cond_signal(&analysis->space);
+    pthread_mutex_unlock(&analysis->lock);
+    pthread_join(analysis->thread, NULL);
+    pthread_mutex_destroy(&analysis->lock);
+    pthread_cond_destroy(&analysis->ready);
+    pthread_cond_destroy(&analysis->space);
+    free(analysis);
+}
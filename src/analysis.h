@@ -0,0 +1,49 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "trie.h"
+
+#define ANALYSIS_RING_SIZE (1 << 16)    // number of positions the analysis thread can run ahead
+#define ANALYSIS_BATCH (1 << 12)        // a waiting side is woken when this many positions are ready for it
+
+// thread that runs ahead of the coder over the input, counts the strings at every position
+// and proposes the length of a new string for each position
+// proposals are passed through a lock-free ring with one producer and one consumer
+// a side that has to wait blocks on a condition variable until ANALYSIS_BATCH positions are ready for it,
+// so the threads do not wake each other for every position, the other side only signals while it waits
+typedef struct Analysis {
+
+    // input, must be completely in memory
+    const char* data;
+    size_t size;
+
+    int max_chars;      // maximum length of a proposal
+    int ladder;         // only propose lengths of 1, 2, 4, 8, ...
+    int max_trie_nodes; // counting trie is cleared when it has this many nodes
+    Trie* trie;         // counting trie, only used by the analysis thread
+
+    // proposal for position i is stored in ring[i % ANALYSIS_RING_SIZE]
+    unsigned char ring[ANALYSIS_RING_SIZE];
+    atomic_size_t head; // number of positions analysed
+    atomic_size_t tail; // positions before tail are no longer needed by the coder
+    atomic_int stop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;       // signaled when head moves while the coder waits
+    pthread_cond_t space;       // signaled when tail moves or on stop while the analysis thread waits
+    atomic_int coder_waiting;
+    atomic_int analysis_waiting;
+    atomic_size_t coder_wake;       // head the waiting coder is woken at
+    atomic_size_t analysis_wake;    // tail the waiting analysis thread is woken at
+
+    pthread_t thread;
+
+} Analysis;
+
+Analysis* start_analysis(const char* data, size_t size, int max_chars, int ladder, int max_trie_nodes, Trie* trie);
+int analysis_proposal(Analysis* analysis, size_t pos);
+void stop_analysis(Analysis* analysis);
+
+#endif // ANALYSIS_H
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "arena.h"
+#include "huffman_util.h"
+
+#define ARENA_ALIGN sizeof(void*)
+
+// internal functions
+Arena_block* new_block(size_t size);
+
+// initialize empty arena, blocks are allocated on first use
+Arena* init_arena() {
+    return (Arena*)safe_calloc(1, sizeof(Arena));
+}
+
+Arena_block* new_block(size_t size) {
+    Arena_block* block = (Arena_block*)safe_malloc(sizeof(Arena_block) + size);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+// allocate zeroed memory from arena, aligned for pointers
+void* arena_alloc(Arena* arena, size_t size) {
+
+    // round size up to alignment
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    Arena_block* block = arena->curr;
+    // find a block with enough space, reuse blocks left over from a reset first
+    while (!block || block->used + size > block->size) {
+        if (block && block->next) {
+            block = block->next;
+            block->used = 0;
+            continue;
+        }
+        Arena_block* new = new_block(size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE);
+        arena->allocated += new->size;
+        if (block) {
+            block->next = new;
+        } else {
+            arena->first = new;
+        }
+        block = new;
+    }
+    arena->curr = block;
+
+    void* ptr = (char*)(block + 1) + block->used;
+    block->used += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+// make sure at least <size> bytes can be allocated without allocating new blocks
+void arena_reserve(Arena* arena, size_t size) {
+
+    // count free space in current and following blocks
+    size_t free_space = 0;
+    Arena_block* last = arena->curr;
+    for (Arena_block* block = arena->curr; block; block = block->next) {
+        free_space += block->size - (block == arena->curr ? block->used : 0);
+        last = block;
+    }
+    if (free_space >= size) return;
+
+    // add one block large enough for the remainder
+    Arena_block* new = new_block(size - free_space);
+    arena->allocated += new->size;
+    if (last) {
+        last->next = new;
+    } else {
+        arena->first = new;
+        arena->curr = new;
+    }
+}
+
+// mark all memory as free, but keep the blocks
+void reset_arena(Arena* arena) {
+    arena->curr = arena->first;
+    if (arena->curr) {
+        arena->curr->used = 0;
+    }
+}
+
+// free arena and all its blocks
+void free_arena(Arena* arena) {
+    if (arena) {
+        Arena_block* block = arena->first;
+        while (block) {
+            Arena_block* next = block->next;
+            free(block);
+            block = next;
+        }
+        free(arena);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (1 << 16)  // 64 KiB per block
+
+// block of memory in an arena
+typedef struct Arena_block {
+    struct Arena_block* next;
+    size_t size;    // usable bytes in data
+    size_t used;    // bytes handed out
+    // data follows the block header
+} Arena_block;
+
+// bump allocator for many small objects that are freed all at once
+// reset_arena keeps the blocks, so the memory can be reused without new allocations
+typedef struct Arena {
+    Arena_block* first; // first block, blocks are reused in list order after a reset
+    Arena_block* curr;  // block allocations are taken from
+    size_t allocated;   // total bytes in blocks
+} Arena;
+
+Arena* init_arena();
+void* arena_alloc(Arena* arena, size_t size);
+void arena_reserve(Arena* arena, size_t size);
+void reset_arena(Arena* arena);
+void free_arena(Arena* arena);
+
+#endif // ARENA_H
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "huffman_util.h"
+#include "trie.h"
+
+// internal functions
+char** read_file_list(const char* list, int* num_files);
+void add_file(char*** files, int* num_files, int* capacity, char* file);
+int has_extension(const char* file, const char* ext);
+void* batch_worker(void* arg);
+int next_file(Batch* batch, int worker);
+void compress_file(Batch* batch, Tree* tree, Trie* trie, const char* file);
+
+typedef struct Worker {
+    Batch* batch;
+    int id;
+} Worker;
+
+
+// compress all files in a directory or in a list file (one file per line, - for standard input)
+// each file is compressed to a file with the same name followed by .persen
+// files are divided over <workers> threads, idle threads steal files from busy ones
+// prints aggregate throughput and returns the number of files that could not be compressed
+int compress_batch(huffman_options* opts, const char* list, int workers) {
+
+    Batch batch;
+    batch.files = read_file_list(list, &batch.num_files);
+    batch.workers = workers;
+    batch.bytes_in = 0;
+    batch.bytes_out = 0;
+    batch.failed = 0;
+    pthread_mutex_init(&batch.lock, NULL);
+
+    // every file is compressed by a single thread, io threads per file would only compete with the workers
+    huffman_options batch_opts = *opts;
+    batch_opts.pipelined = 0;
+    batch.opts = &batch_opts;
+
+    // divide files round robin over the workers
+    batch.deques = (Deque*)safe_calloc(workers, sizeof(Deque));
+    for (int w = 0; w < workers; w++) {
+        Deque* deque = &batch.deques[w];
+        deque->items = (int*)safe_malloc(sizeof(int) * (batch.num_files / workers + 1));
+        pthread_mutex_init(&deque->lock, NULL);
+    }
+    for (int i = 0; i < batch.num_files; i++) {
+        Deque* deque = &batch.deques[i % workers];
+        deque->items[deque->bottom++] = i;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t threads[workers];
+    Worker worker_args[workers];
+    for (int w = 0; w < workers; w++) {
+        worker_args[w].batch = &batch;
+        worker_args[w].id = w;
+        if (pthread_create(&threads[w], NULL, batch_worker, &worker_args[w])) {
+            fprintf(stderr, "[%s:%i] could not start worker thread\n", __FILE__, __LINE__);
+            exit(1);
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("compressed %i files (%i failed) with %i threads\n", batch.num_files - batch.failed, batch.failed, workers);
+    printf("%llu -> %llu bytes (%.1f%%)\n", batch.bytes_in, batch.bytes_out,
+        batch.bytes_in ? 100.0 * batch.bytes_out / batch.bytes_in : 0.0);
+    printf("%.3f s, %.2f MiB/s, %.1f files/s\n", seconds,
+        seconds > 0 ? batch.bytes_in / seconds / (1 << 20) : 0.0,
+        seconds > 0 ? batch.num_files / seconds : 0.0);
+
+    for (int w = 0; w < workers; w++) {
+        free(batch.deques[w].items);
+        pthread_mutex_destroy(&batch.deques[w].lock);
+    }
+    free(batch.deques);
+    for (int i = 0; i < batch.num_files; i++) {
+        free(batch.files[i]);
+    }
+    free(batch.files);
+    pthread_mutex_destroy(&batch.lock);
+
+    return batch.failed;
+}
+
+// worker thread, compresses files until no worker has files left
+// the tree and counting trie are reused for all files of this worker
+void* batch_worker(void* arg) {
+    Worker* worker = (Worker*)arg;
+
+    Tree* tree = init_tree();
+    Trie* trie = init_trie();
+
+    int i;
+    while ((i = next_file(worker->batch, worker->id)) >= 0) {
+        compress_file(worker->batch, tree, trie, worker->batch->files[i]);
+    }
+
+    free_tree(tree);
+    free_trie(trie);
+    return NULL;
+}
+
+// take next file from own deque, if empty steal one from another worker
+// returns -1 if all deques are empty
+int next_file(Batch* batch, int worker) {
+
+    Deque* own = &batch->deques[worker];
+    pthread_mutex_lock(&own->lock);
+    int i = own->top < own->bottom ? own->items[--own->bottom] : -1;
+    pthread_mutex_unlock(&own->lock);
+    if (i >= 0) return i;
+
+    // steal from the top of the other deques, files are never added so one pass is enough
+    for (int w = 1; w < batch->workers; w++) {
+        Deque* victim = &batch->deques[(worker + w) % batch->workers];
+        pthread_mutex_lock(&victim->lock);
+        i = victim->top < victim->bottom ? victim->items[victim->top++] : -1;
+        pthread_mutex_unlock(&victim->lock);
+        if (i >= 0) return i;
+    }
+    return -1;
+}
+
+// compress one file to <file>.persen
+void compress_file(Batch* batch, Tree* tree, Trie* trie, const char* file) {
+
+    char outname[strlen(file) + sizeof(BATCH_EXTENSION)];
+    strcpy(outname, file);
+    strcat(outname, BATCH_EXTENSION);
+
+    FILE* inputfile = fopen(file, "rb");
+    FILE* outputfile = inputfile ? fopen(outname, "wb") : NULL;
+    if (!inputfile || !outputfile) {
+        fprintf(stderr, "Error: could not open %s\n", inputfile ? outname : file);
+        if (inputfile) fclose(inputfile);
+        pthread_mutex_lock(&batch->lock);
+        batch->failed++;
+        pthread_mutex_unlock(&batch->lock);
+        return;
+    }
+
+    compress_tree(tree, trie, batch->opts, inputfile, outputfile);
+
+    // mapped input does not move the file position, so the input size is taken from the file
+    struct stat st;
+    long bytes_in = fstat(fileno(inputfile), &st) == 0 ? (long)st.st_size : 0;
+    long bytes_out = ftell(outputfile);
+    fclose(inputfile);
+    fclose(outputfile);
+
+    pthread_mutex_lock(&batch->lock);
+    batch->bytes_in += bytes_in > 0 ? bytes_in : 0;
+    batch->bytes_out += bytes_out > 0 ? bytes_out : 0;
+    pthread_mutex_unlock(&batch->lock);
+}
+
+// read list of files to compress
+// if list is a directory, all regular files in it are used, except files that are already compressed
+// else list is a file with one file name per line, - reads the list from standard input
+char** read_file_list(const char* list, int* num_files) {
+
+    char** files = NULL;
+    int capacity = 0;
+    *num_files = 0;
+
+    struct stat st;
+    if (strcmp(list, "-") != 0 && stat(list, &st) == 0 && S_ISDIR(st.st_mode)) {
+
+        DIR* dir = opendir(list);
+        if (!dir) {
+            fprintf(stderr, "Error: could not open directory %s\n", list);
+            exit(1);
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir))) {
+            if (has_extension(entry->d_name, BATCH_EXTENSION)) continue;
+
+            char* file = (char*)safe_malloc(strlen(list) + strlen(entry->d_name) + 2);  // +2 for / and null byte
+            sprintf(file, "%s/%s", list, entry->d_name);
+            if (stat(file, &st) == 0 && S_ISREG(st.st_mode)) {
+                add_file(&files, num_files, &capacity, file);
+            } else {
+                free(file);
+            }
+        }
+        closedir(dir);
+
+    } else {
+
+        FILE* listfile = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+        if (!listfile) {
+            fprintf(stderr, "Error: could not open file list %s\n", list);
+            exit(1);
+        }
+        char line[4096];
+        while (fgets(line, sizeof(line), listfile)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0') continue;
+            add_file(&files, num_files, &capacity, strdup(line));
+        }
+        if (listfile != stdin) fclose(listfile);
+    }
+
+    return files;
+}
+
+// append file to dynamic array of files
+void add_file(char*** files, int* num_files, int* capacity, char* file) {
+    if (*num_files == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *files = (char**)safe_realloc(*files, sizeof(char*) * *capacity);
+    }
+    (*files)[(*num_files)++] = file;
+}
+
+// check if file name ends with extension
+int has_extension(const char* file, const char* ext) {
+    size_t len = strlen(file);
+    size_t ext_len = strlen(ext);
+    return len >= ext_len && strcmp(&file[len - ext_len], ext) == 0;
+}
@@ -0,0 +1,38 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <pthread.h>
+#include "huffman.h"
+
+#define BATCH_EXTENSION ".persen"   // appended to the name of each compressed file
+
+// files of one worker, the worker takes files from the bottom, other workers steal from the top
+typedef struct Deque {
+    int* items;     // indices in file list
+    int top;
+    int bottom;     // items top .. bottom-1 are left
+    pthread_mutex_t lock;
+} Deque;
+
+// shared state of a batch run
+typedef struct Batch {
+
+    char** files;
+    int num_files;
+
+    Deque* deques;  // one per worker
+    int workers;
+
+    huffman_options* opts;
+
+    // totals, protected by lock
+    pthread_mutex_t lock;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    int failed;
+
+} Batch;
+
+int compress_batch(huffman_options* opts, const char* list, int workers);
+
+#endif // BATCH_H
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "huffman_util.h"
+#include "header.h"
+#include "trie.h"
+#include "arena.h"
+
+// type of a node in the checkpoint file
+#define CHECKPOINT_INTERNAL 0
+#define CHECKPOINT_LEAF 1
+#define CHECKPOINT_NYT 2
+
+// children of a trie node in the checkpoint file
+#define CHECKPOINT_TRIE_LEFT 0x01
+#define CHECKPOINT_TRIE_NEXT 0x02
+#define CHECKPOINT_TRIE_RIGHT 0x04
+
+// internal functions
+void save_tree(huffman_io* io, Tree* tree);
+void save_trie(huffman_io* io, Trie* trie);
+int load_tree(huffman_io* io, Tree* tree);
+int load_trie(huffman_io* io, Trie* trie);
+int read_field(huffman_io* io, unsigned long long max, unsigned long long* value);
+
+
+// save encoder state, tree and counting trie to a file
+// the file is written under a temporary name first, so an existing checkpoint is only replaced by a complete one
+// returns 0 if ok, -1 if the file could not be written
+int save_checkpoint(const char* filename, Checkpoint* state, Tree* tree, Trie* trie) {
+
+    size_t len = strlen(filename);
+    char tmp_name[len + 5];
+    memcpy(tmp_name, filename, len);
+    memcpy(&tmp_name[len], ".tmp", 5);
+
+    FILE* file = fopen(tmp_name, "wb");
+    if (!file) return -1;
+
+    huffman_io io = init_io(file, WRITE);
+    write_bytes(&io, CHECKPOINT_MAGIC, 4);
+    io_putc(&io, CHECKPOINT_VERSION);
+    write_varint(&io, state->max_chars);
+    write_varint(&io, state->max_mem);
+    write_varint(&io, state->level);
+    write_varint(&io, state->lazy);
+    write_varint(&io, state->cost);
+    write_varint(&io, state->max_depth);
+    write_varint(&io, state->end_bits);
+    write_varint(&io, state->file_size);
+    write_varint(&io, state->total_encoded);
+    write_varint(&io, state->total_bits);
+    save_tree(&io, tree);
+    save_trie(&io, trie);
+    close_io(&io);
+
+    int failed = ferror(file);
+    failed |= fclose(file);
+    if (failed || rename(tmp_name, filename)) {
+        remove(tmp_name);
+        return -1;
+    }
+    return 0;
+}
+
+// nodes in order of the order list, so the order of a node is its index
+// internal nodes refer to their children by order, children always come after their parent
+void save_tree(huffman_io* io, Tree* tree) {
+    write_varint(io, tree->nodes);
+    for (Node* node = tree->root; node; node = node->next_ord) {
+        if (node == tree->nyt) {
+            io_putc(io, CHECKPOINT_NYT);
+            write_varint(io, node->weight);
+        } else if (node->left) {
+            io_putc(io, CHECKPOINT_INTERNAL);
+            write_varint(io, node->weight);
+            write_varint(io, node->left->order);
+            write_varint(io, node->right->order);
+        } else {
+            io_putc(io, CHECKPOINT_LEAF);
+            write_varint(io, node->weight);
+            io_putc(io, (uint8)node->strlength);
+            write_bytes(io, node->string, node->strlength);
+        }
+    }
+}
+
+// trie nodes in preorder: node, smaller characters, next character, greater characters
+// each node is stored as its character, a byte with the children it has and its count
+void save_trie(huffman_io* io, Trie* trie) {
+    write_varint(io, trie->nodes);
+    if (!trie->root) return;
+
+    // explicit stack, sibling chains can be too long for recursion
+    Trie_node** stack = (Trie_node**)safe_malloc((trie->nodes + 1) * sizeof(Trie_node*));
+    int top = 0;
+    stack[top++] = trie->root;
+    while (top > 0) {
+        Trie_node* node = stack[--top];
+        io_putc(io, (uint8)node->character);
+        io_putc(io, (node->left ? CHECKPOINT_TRIE_LEFT : 0) | (node->next ? CHECKPOINT_TRIE_NEXT : 0) | (node->right ? CHECKPOINT_TRIE_RIGHT : 0));
+        write_varint(io, node->data.count);
+
+        // pushed in reverse, so the smaller characters are written first
+        if (node->right) stack[top++] = node->right;
+        if (node->next) stack[top++] = node->next;
+        if (node->left) stack[top++] = node->left;
+    }
+    free(stack);
+}
+
+// load state saved by save_checkpoint, tree and trie are replaced by the saved ones
+// trie may be NULL if the counting trie is not needed, i.e. to decode
+// returns 0 if ok, -1 if the file could not be read or is not a valid checkpoint, tree is then empty
+int load_checkpoint(const char* filename, Checkpoint* state, Tree* tree, Trie* trie) {
+
+    FILE* file = fopen(filename, "rb");
+    if (!file) return -1;
+    huffman_io io = init_io(file, READ);
+
+    char magic[4];
+    unsigned long long fields[10];
+    int failed = read_bytes(&io, magic, 4) != 4 || memcmp(magic, CHECKPOINT_MAGIC, 4) || io_getc(&io) != CHECKPOINT_VERSION;
+    for (int i = 0; i < 10 && !failed; i++) {
+        failed = read_varint(&io, &fields[i]);
+    }
+    if (!failed) {
+        state->max_chars = (int)fields[0];
+        state->max_mem = (int)fields[1];
+        state->level = (int)fields[2];
+        state->lazy = (int)fields[3];
+        state->cost = (int)fields[4];
+        state->max_depth = (int)fields[5];
+        state->end_bits = fields[6];
+        state->file_size = fields[7];
+        state->total_encoded = fields[8];
+        state->total_bits = fields[9];
+        state->restored = 1;
+        failed = fields[0] < 1 || fields[0] > 255 || fields[1] > 9 || fields[2] < 1 || fields[2] > 9 || fields[3] > 2 || fields[4] > 1;
+        failed = failed || (fields[5] && (fields[5] < MIN_MAX_DEPTH || fields[5] > MAX_MAX_DEPTH));
+    }
+    failed = failed || load_tree(&io, tree) || (trie && load_trie(&io, trie));
+
+    close_io(&io);
+    fclose(file);
+    if (failed) {
+        reset_tree(tree);
+        if (trie) clear_trie(trie);
+        return -1;
+    }
+    return 0;
+}
+
+// read tree saved by save_tree, every node must have exactly one parent that comes before it
+// returns 0 if ok, -1 if the tree is not valid
+int load_tree(huffman_io* io, Tree* tree) {
+
+    reset_tree(tree);
+    unsigned long long n;
+    if (read_field(io, 1 << 30, &n) || n % 2 == 0) return -1;
+
+    // the root of the empty tree is reused for the first node
+    Node** nodes = (Node**)safe_malloc(n * sizeof(Node*));
+    nodes[0] = tree->root;
+    for (unsigned long long i = 1; i < n; i++) {
+        nodes[i] = (Node*)arena_alloc(tree->arena, sizeof(Node));   // arena memory is set to 0
+    }
+    tree->nyt = NULL;
+
+    int failed = 0;
+    for (unsigned long long i = 0; i < n && !failed; i++) {
+        Node* node = nodes[i];
+        node->order = (unsigned int)i;
+        node->prev_ord = i > 0 ? nodes[i-1] : NULL;
+        node->next_ord = i+1 < n ? nodes[i+1] : NULL;
+        if (i > 0 && !node->parent) {
+            failed = 1;     // no internal node before it has this child
+            break;
+        }
+
+        int type = io_getc(io);
+        unsigned long long weight, left, right;
+        if (read_field(io, ~0U, &weight)) {
+            failed = 1;
+            break;
+        }
+        node->weight = (unsigned int)weight;
+
+        if (type == CHECKPOINT_NYT) {
+            failed = i != n-1 || weight != 0;   // nyt is always last in the order list
+            tree->nyt = node;
+        } else if (type == CHECKPOINT_INTERNAL) {
+            failed = read_field(io, n-1, &left) || read_field(io, n-1, &right) || left <= i || right <= i || left == right;
+            if (failed || nodes[left]->parent || nodes[right]->parent) {
+                failed = 1;
+                break;
+            }
+            node->left = nodes[left];
+            node->right = nodes[right];
+            node->left->parent = node;
+            node->right->parent = node;
+        } else if (type == CHECKPOINT_LEAF) {
+            int length = io_getc(io);
+            if (length < 1) {
+                failed = 1;
+                break;
+            }
+            node->string = (char*)arena_alloc(tree->arena, length + 1);  // string is null terminated by the arena
+            node->strlength = length;
+            failed = read_bytes(io, node->string, length) != (size_t)length;
+
+            // add leaf to lookup table or trie, as add_new does
+            if (length == 1) {
+                tree->byte_leaf[(uint8)node->string[0]] = node;
+            } else {
+                trie_add_string_node(tree->trie, node->string, length, node);
+            }
+        } else {
+            failed = 1;
+        }
+    }
+    tree->root = nodes[0];
+    tree->nodes = (int)n;
+    free(nodes);
+
+    return failed || !tree->nyt ? -1 : 0;
+}
+
+// read trie saved by save_trie, the node count must match the preorder
+// returns 0 if ok, -1 if the trie is not valid
+int load_trie(huffman_io* io, Trie* trie) {
+
+    clear_trie(trie);
+    unsigned long long n;
+    if (read_field(io, 1 << 30, &n)) return -1;
+
+    // stack of links still to be filled, the root link first
+    Trie_node*** stack = (Trie_node***)safe_malloc((n + 1) * sizeof(Trie_node**));
+    int top = 0;
+    if (n > 0) stack[top++] = &trie->root;
+
+    int failed = 0;
+    for (unsigned long long i = 0; i < n; i++) {
+        int c = io_getc(io);
+        int children = io_getc(io);
+        unsigned long long count;
+        if (top == 0 || c == EOF || children == EOF || read_field(io, 0x7fffffff, &count)) {
+            failed = 1;
+            break;
+        }
+        Trie_node* node = (Trie_node*)arena_alloc(trie->arena, sizeof(Trie_node));   // arena memory is set to 0
+        node->character = (char)c;
+        node->data.count = (int)count;
+        *stack[--top] = node;
+
+        if (children & CHECKPOINT_TRIE_RIGHT) stack[top++] = &node->right;
+        if (children & CHECKPOINT_TRIE_NEXT) stack[top++] = &node->next;
+        if (children & CHECKPOINT_TRIE_LEFT) stack[top++] = &node->left;
+        if ((unsigned long long)top > n - i - 1) {
+            failed = 1;     // more links than nodes left
+            break;
+        }
+    }
+    free(stack);
+
+    trie->nodes = (int)n;
+    return failed || top != 0 ? -1 : 0;
+}
+
+// read varint of at most max, returns 0 if ok, -1 if it is missing or too large
+int read_field(huffman_io* io, unsigned long long max, unsigned long long* value) {
+    return read_varint(io, value) || *value > max ? -1 : 0;
+}
+
+// remember the position in the stream where the end of input marker is written next
+void mark_stream_end(Checkpoint* state, huffman_io* io) {
+    // bits_set may be 8, then curr_byte is a full byte that is not yet in the buffer
+    state->end_bits = (io->bytes_out + io->buf_pos) * 8 + io->bits_set;
+}
+
+// prepare io to continue the stream of its file at the end of input marker
+// the file is cut before the byte of the marker, the bits of that byte that belong to the stream are kept in io
+// returns 0 if ok, -1 if the file is not the one the checkpoint was saved for or cannot be changed
+int resume_output(huffman_io* io, Checkpoint* state) {
+
+    struct stat st;
+    if (fstat(fileno(io->file), &st) || (unsigned long long)st.st_size != state->file_size) return -1;
+
+    off_t bytes = (off_t)(state->end_bits / 8);
+    int bits = (int)(state->end_bits % 8);
+    int last = 0;
+    if (bits > 0) {
+        if (fseeko(io->file, bytes, SEEK_SET) || (last = fgetc(io->file)) == EOF) return -1;
+    }
+    if (fflush(io->file) || ftruncate(fileno(io->file), bytes) || fseeko(io->file, bytes, SEEK_SET)) return -1;
+
+    // write_bit keeps the bits of an incomplete byte in the low bits of curr_byte
+    io->curr_byte = (uint8)(last >> (8 - bits));
+    io->bits_set = bits;
+    io->bytes_out = (unsigned long long)bytes;
+    return 0;
+}
+
+// prepare io to decode the stream of its file from the end of input marker of a checkpoint
+// the rest of the stream is what was appended after the checkpoint was saved
+// returns 0 if ok, -1 if the file cannot be read from there
+int resume_input(huffman_io* io, Checkpoint* state) {
+
+    if (io->pipe || fseeko(io->file, (off_t)(state->end_bits / 8), SEEK_SET)) return -1;
+    io->buf_pos = 0;
+    io->buf_len = 0;
+    io->bits_set = 8;   // read first byte on the first bit
+    io->eof_reached = 0;
+
+    // skip bits of the byte that were written before the checkpoint
+    for (unsigned long long i = 0; i < state->end_bits % 8; i++) {
+        read_bit(io);
+    }
+    return io->eof_reached ? -1 : 0;
+}
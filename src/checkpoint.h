@@ -0,0 +1,42 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "huffman.h"
+#include "huffman_io.h"
+
+#define CHECKPOINT_EXTENSION ".ckpt"    // checkpoint of an output file is saved next to it
+#define CHECKPOINT_MAGIC "PSCK"
+#define CHECKPOINT_VERSION 1
+
+// state of the encoder at the end of input, so more input can be appended to the same stream later
+// the tree and counting trie are saved with it, the stream continues where its end of input marker starts
+// only for streams with one lane and without contexts
+// file layout: magic, version, the fields below as varints, the tree nodes in order of the order list,
+// then the counting trie in preorder, see checkpoint.c
+typedef struct Checkpoint {
+
+    // settings of the stream, an append continues with the same settings
+    int max_chars;
+    int max_mem;
+    int level;
+    int lazy;
+    int cost;
+    int max_depth;
+
+    unsigned long long end_bits;    // bit position of the end of input marker in the stream
+    unsigned long long file_size;   // size of the stream, an append refuses a file that changed since
+    unsigned long long total_encoded;   // number of input bytes coded
+    unsigned long long total_bits;      // number of bits output for them, for the rate of -s
+
+    int restored;   // tree and trie hold this state, the encoder continues the stream instead of starting one
+
+} Checkpoint;
+
+int save_checkpoint(const char* filename, Checkpoint* state, Tree* tree, Trie* trie);
+int load_checkpoint(const char* filename, Checkpoint* state, Tree* tree, Trie* trie);
+
+void mark_stream_end(Checkpoint* state, huffman_io* io);
+int resume_output(huffman_io* io, Checkpoint* state);
+int resume_input(huffman_io* io, Checkpoint* state);
+
+#endif // CHECKPOINT_H
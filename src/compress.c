@@ -5,120 +5,385 @@
 #include "huffman_io.h"
 #include "huffman_util.h"
 #include "trie.h"
+#include "lookahead.h"
+#include "header.h"
+#include "analysis.h"
+#include "stats.h"
+#include "tune.h"
+#include "lanes.h"
+#include "context.h"
+#include "dict.h"
+#include "checkpoint.h"
+#include "dedup.h"
+#include "lz77.h"
+#include "rle.h"
+#include "probe.h"
 
 const int MEM_LIMIT[] = {75000, 75000, 100000, 200000, 1000000, 20000000, 50000000, 100000000, 500000000, 1000000000};
 
+// speed settings of a compression level
+typedef struct level_params {
+    int probe_depth;    // maximum length of the strings considered at each position
+    int count_on_hit;   // also add strings to the counting trie if a string is found in the tree
+    int ladder;         // only make new strings with a length of 1, 2, 4, 8, ...
+} level_params;
+
+// each level caps the number of characters probed at each position, level 9 considers every string
+// a deeper probe takes longer, but the levels are not ranked by ratio, on some input a lower level compresses better
+// levels 1 and 2 only make new strings with a length of a power of 2
+// lengths are also limited by LEN
+const level_params LEVELS[] = {
+    {  0, 0, 0},    // not used
+    {  8, 0, 1},
+    { 16, 0, 1},
+    { 16, 0, 0},
+    { 24, 0, 0},
+    { 32, 0, 0},
+    { 48, 0, 0},
+    { 64, 1, 0},
+    {128, 1, 0},
+    {255, 1, 0}
+};
+
 // internal functions
-path path_to_root(Tree* tree, Node* node);
-void strshiftl(char* str, int length, int n);
-int calc_max_tree_nodes(int max_mem, int max_chars);
+int write_path(huffman_io* io, path p);
+void encode_bytes(Lanes* lanes, Contexts* contexts, uint8 prev, Trie* trie, Lookahead* la, huffman_options* opts, unsigned long long* total_encoded, unsigned long long* total_bits, unsigned long long* next_stats, Checkpoint* state);
+int cheapest_length(Tree* tree, const char* str, int probe, int hit, int* counts, int ladder, double rate, Node** node);
 int calc_max_trie_nodes(int max_mem);
+void compress_source(Tree* tree, Trie* trie, huffman_options* opts, FILE* inputfile, const char* data, size_t len, FILE* outputfile);
 
 // compress an input file using huffman coding
-void compress(int max_chars, int max_mem, FILE* inputfile, FILE* outputfile) {
+void compress(huffman_options* opts, FILE* inputfile, FILE* outputfile) {
+
+    Tree* tree = init_tree();
+    Trie* trie = init_trie();
+
+    compress_tree(tree, trie, opts, inputfile, outputfile);
+
+    free_tree(tree);
+    free_trie(trie);
+}
+
+// compress an input file with a given huffman tree and counting trie
+// both are reset first, this way their memory can be reused for multiple files
+// with a checkpoint, the state of the encoder is saved at the end, to append it is restored first
+void compress_tree(Tree* tree, Trie* trie, huffman_options* opts, FILE* inputfile, FILE* outputfile) {
+    compress_source(tree, trie, opts, inputfile, NULL, 0, outputfile);
+}
+
+// compress input that is already in memory, like compress_tree, the input is not copied and its size is stored
+void compress_memory(Tree* tree, Trie* trie, huffman_options* opts, const char* data, size_t len, FILE* outputfile) {
+    compress_source(tree, trie, opts, NULL, data, len, outputfile);
+}
+
+// compress the input file, or data if inputfile is NULL
+void compress_source(Tree* tree, Trie* trie, huffman_options* opts, FILE* inputfile, const char* data, size_t len, FILE* outputfile) {
+
+    // an append continues the stream with the tree, trie and settings of the checkpoint
+    Checkpoint state;
+    state.restored = 0;     // a new stream, unless the checkpoint is loaded below
+    huffman_options tuned = *opts;
+    if (opts->append) {
+        if (load_checkpoint(opts->checkpoint, &state, tree, trie)) {
+            fprintf(stderr, "Error: could not read checkpoint %s\n", opts->checkpoint);
+            exit(1);
+        }
+        tuned.max_chars = state.max_chars;
+        tuned.max_mem = state.max_mem;
+        tuned.level = state.level;
+        tuned.lazy = state.lazy;
+        tuned.cost = state.cost;
+        tuned.max_depth = state.max_depth;
+    }
+
+    // window on input of <max_chars> bytes, plus the positions checked by lazy matching
+    // with -c auto the window is set after LEN is chosen
+    // with dedup, all input is read first and only its distinct chunks are coded
+    Lookahead la;
+    Dedup* dedup = NULL;
+    int max_chars = tuned.max_chars ? tuned.max_chars : 255;
+    if (opts->dedup) {
+        dedup = inputfile ? dedup_input(inputfile) : dedup_memory(data, len);
+        init_lookahead_memory(&la, dedup->unique, dedup->unique_len, max_chars + tuned.lazy);
+    } else if (inputfile) {
+        init_lookahead(&la, inputfile, max_chars + tuned.lazy, opts->pipelined);
+    } else {
+        init_lookahead_memory(&la, data, len, max_chars + tuned.lazy);
+    }
+
+    // choose LEN and MEM on a sample of the input, the LZ77 engine does not use LEN
+    if (!tuned.max_chars && !tuned.window) {
+        tune_options(&tuned, tree, trie, &la);
+        la.window = tuned.max_chars + tuned.lazy;
+    }
+
+    huffman_io io = opts->pipelined ? init_pipelined_io(outputfile, WRITE) : init_io(outputfile, WRITE);
+    if (opts->append && resume_output(&io, &state)) {
+        fprintf(stderr, "Error: output file was changed after checkpoint %s was saved\n", opts->checkpoint);
+        exit(1);
+    }
+    if (tuned.window) {
+        encode_lz77(tree, &tuned, &la, &io);
+    } else {
+        encode_input(tree, trie, &tuned, &la, &io, opts->checkpoint ? &state : NULL);
+    }
+    if (dedup) {
+        write_chunks(&io, dedup);
+        free_dedup(dedup);
+    }
+    close_io(&io);
+    close_lookahead(&la);
+
+    if (opts->checkpoint) {
+        state.file_size = io.bytes_out;
+        if (save_checkpoint(opts->checkpoint, &state, tree, trie)) {
+            fprintf(stderr, "Error: could not write checkpoint %s\n", opts->checkpoint);
+            exit(1);
+        }
+    }
+}
+
+// encode all input in lookahead to out, starting with the header
+// tree and trie are reset first, tree is used for lane 0
+// if state is given, the position of the end of input marker and the settings are stored in it,
+// and if state was restored, tree and trie are kept and the stream is continued without a header
+void encode_input(Tree* first_tree, Trie* trie, huffman_options* opts, Lookahead* la, huffman_io* out, Checkpoint* state) {
+
+    int max_chars = opts->max_chars;
+    int max_mem = opts->max_mem;
 
-    // calculate maximum number of tree and trie nodes
-    int max_tree_nodes = calc_max_tree_nodes(max_mem, max_chars);
+    // calculate maximum number of tree and trie nodes, the trees of all lanes share the memory
+    // with contexts, half of the tree memory is for the context trees
+    int max_tree_nodes = calc_max_tree_nodes(max_mem, max_chars) / opts->lanes;
+    if (opts->contexts) max_tree_nodes /= 2;
+    max_tree_nodes = bounded_tree_nodes(max_tree_nodes, opts->max_depth);
     DEBUG_PRINT("max tree nodes: %i\n", max_tree_nodes);
     int max_trie_nodes = calc_max_trie_nodes(max_mem);
     DEBUG_PRINT("max trie nodes: %i\n", max_trie_nodes);
 
-    Tree* tree = init_tree();
-    huffman_io io = init_io(outputfile, WRITE);
-    Trie* trie = init_trie();
+    int restored = state && state->restored;
+    if (!restored) {
+        reset_tree(first_tree);
+        clear_trie(trie);
+    }
+    Lanes lanes;
+    init_lanes(&lanes, opts->lanes, first_tree, out);
+    Contexts* contexts = opts->contexts ? init_contexts(opts->contexts, max_tree_nodes) : NULL;
+    uint8 prev = 0;     // last character encoded, selects the context
+    if (opts->rle && !restored) {
+        add_run_leaf(first_tree);
+    }
+    for (int i = 0; i < lanes.n; i++) {
+        set_max_depth(lanes.trees[i], opts->max_depth);
+        if (opts->dict && !restored) prime_tree(lanes.trees[i], opts->dict, max_chars);
+    }
+    if (contexts) {
+        contexts->max_depth = opts->max_depth;
+    }
+
+    // write header, the size of the input is only known if it is mapped or in memory
+    // a stream that can be appended to has no size, with dedup the lookahead only holds the distinct chunks
+    int sized = la->whole && !state && !opts->dedup;
+    Header header;
+    header.max_chars = max_chars;
+    header.max_mem = max_mem;
+    header.engine = max_chars == 1 ? ENGINE_BYTES : ENGINE_STRINGS;
+    header.flags = (sized ? HEADER_HAS_SIZE : 0) | (lanes.n > 1 ? HEADER_HAS_LANES : 0) | (contexts ? HEADER_HAS_CONTEXTS : 0) | (opts->dict ? HEADER_HAS_DICT : 0) | (opts->max_depth ? HEADER_HAS_MAX_DEPTH : 0) | (opts->dedup ? HEADER_HAS_DEDUP : 0) | (opts->rle ? HEADER_HAS_RUNS : 0);
+    header.original_size = sized ? la->len : 0;
+    header.lanes = lanes.n;
+    header.contexts = opts->contexts;
+    header.dict_id = opts->dict ? opts->dict->id : 0;
+    header.max_depth = opts->max_depth;
+    if (!restored) {
+        write_header(out, &header);
+    }
+
+    // speed settings
+    const level_params* level = &LEVELS[opts->level];
+    int counts[max_chars+1];    // counter of each candidate length
+    Probe_limit probe_limit;    // with -e, the number of characters probed adapts to the input
+    init_probe_limit(&probe_limit, max_chars < level->probe_depth ? max_chars : level->probe_depth);
+
+    // counting on a separate thread, only if the input is in memory
+    Analysis* analysis = NULL;
+    if (opts->analysis && la->map) {
+        int probe = max_chars < level->probe_depth ? max_chars : level->probe_depth;
+        analysis = start_analysis(la->map, la->len, probe, level->ladder, max_trie_nodes, trie);
+    }
+    // the analysis thread owns the counting trie, statistics then leave it out
+    Trie* stats_trie = analysis ? NULL : trie;
 
     // loop over input, encode a number of characters in each iteration
-    char input_str[max_chars+1];    // input string buffer
-    int buf_size = max_chars;   // input buffer size
-    int chars_in_buf = 0;   // number of chars to still in buffer
-    int chars_encoded = max_chars;  // number of characters encoded in previous iteration
-    int total_encoded = 0;  // total number of characters encoded
+    const char* input_str;  // next characters to encode
+    int avail;          // number of characters available in input_str
+    int chars_in_buf;   // number of characters considered for the next string
+    int chars_encoded;  // number of characters encoded in this iteration
+    unsigned long long total_encoded = restored ? state->total_encoded : 0;   // total number of characters encoded
+    unsigned long long total_bits = restored ? state->total_bits : 0;  // total number of bits output
+    unsigned long long next_stats = opts->stats_every;  // number of characters encoded at next statistics export
     int reading = 1;
     while (reading) {
 
+        // tree and bitstream of the lane of this symbol
+        Tree* tree = lanes.trees[lanes.curr];
+        huffman_io* io = lane_io(&lanes);
+
         // if max tree nodes reached, encode only strings of length 1
         if (max_chars > 1 && tree->nodes >= max_tree_nodes) {
             max_chars = 1;
-            DEBUG_PRINT("max nodes (%i) reached after %i bytes encoded\n", max_tree_nodes, total_encoded);
+            DEBUG_PRINT("max nodes (%i) reached after %llu bytes encoded\n", max_tree_nodes, total_encoded);
         }
-        if (trie->nodes >= max_trie_nodes) {
+        // strings of length 1, use the specialized loop for the rest of the input
+        // it needs no proposals, so the analysis thread is stopped
+        if (max_chars == 1) {
+            stop_analysis(analysis);
+            analysis = NULL;
+            encode_bytes(&lanes, contexts, prev, stats_trie, la, opts, &total_encoded, &total_bits, &next_stats, state);
+            break;
+        }
+        if (!analysis && trie->nodes >= max_trie_nodes) {
             clear_trie(trie);
         }
 
-        // shift string if there are still characters in buffer
-        if (chars_in_buf > 0) {
-            strshiftl(input_str, buf_size, chars_encoded);
-        }
-        // read characters
-        int chars_read = fread(&input_str[chars_in_buf], sizeof(char), chars_encoded, inputfile);
-        chars_in_buf += chars_read;
-        // set terminating byte
-        input_str[chars_in_buf] = '\0';
+        // get next characters, no characters are copied
+        input_str = lookahead_peek(la, &avail);
+        chars_in_buf = avail < max_chars ? avail : max_chars;
 
-        DEBUG_PRINT("string: \"%s\"\n", input_str);
+        DEBUG_PRINT("string: \"%.*s\"\n", chars_in_buf, input_str);
         DEBUG_PRINT("chars_in_buf: %d\n", chars_in_buf);
 
+        // a run of one character is coded with the run leaf, it may be longer than the window
+        if (tree->run_leaf && chars_in_buf > 1 && input_str[1] == input_str[0]) {
+            int all;
+            lookahead_peek_all(la, &all);
+            size_t run = run_length(input_str, all < RLE_MAX_RUN ? all : RLE_MAX_RUN);
+            if (run >= RLE_MIN_RUN) {
+                DEBUG_PRINT("run: %zu\n\n", run);
+                total_bits += write_run(io, tree, (uint8)input_str[0], run);
+                prev = (uint8)input_str[0];
+                lookahead_advance(la, (int)run);
+                total_encoded += run;
+                continue;
+            }
+        }
+
         // find string in tree and output path + string if necessary
         int nyt = 0;    // if character was not found in tree (Not Yet Transferred), write character to output
-        path p;
         if (chars_in_buf > 0) {
 
-            int best_length = 1;
-            int best_count = 0;
+            int depth = opts->adaptive ? probe_depth(&probe_limit) : level->probe_depth;
+            int probe = chars_in_buf < depth ? chars_in_buf : depth;
+
+            // find longest string at current position that is already in the tree
             Node* node;
-            if (max_chars > 1) {
-                // choose number of characters to add in node
-                for (int len = chars_in_buf; len > 0; len--) {
+            int hit = tree_longest_prefix(tree, input_str, probe, &node);
+            int best_length = hit ? hit : 1;
 
-                    // add string to trie
-                    int count = trie_increment_string_count(trie, input_str, len);
+            // add strings to counting trie, strings shorter than the one in the tree are never made
+            int counted = !analysis && (!hit || level->count_on_hit);
+            if (counted) {
+                trie_increment_prefix_counts(trie, input_str, probe, hit ? hit : 1, counts);
+            }
 
-                    // check if string already in tree
-                    if ((node = tree_find_node(tree, input_str, len))) {
-                        best_length = len;
-                        break;
-                    }
+            if (analysis) {
+                // the analysis thread already counted, only check its proposal against the tree
+                int proposal = analysis_proposal(analysis, la->pos);
+                if (!hit) {
+                    best_length = proposal < probe ? proposal : probe;
+                }
+            } else if (opts->cost) {
+                // choose string with the fewest bits per character, known or new
+                double rate = total_encoded ? (double)total_bits / total_encoded : 8.0;
+                best_length = cheapest_length(tree, input_str, probe, hit, counted ? counts : NULL, level->ladder, rate, &node);
+            } else if (!hit) {
+                // choose number of characters to add in node
+                int best_count = 0;
+                for (int len = probe; len > 0; len--) {
+                    if (level->ladder && (len & (len-1))) continue;    // length is not a power of 2
 
-                    if (count*len/2 > best_count) {
+                    if (counts[len]*len/2 > best_count) {
                         best_length = len;
-                        best_count = count*len/2;     // times length to favor longer strings
+                        best_count = counts[len]*len/2;     // times length to favor longer strings
                     }
                 }
-            } else {
-                node = tree_find_node(tree, input_str, 1);
             }
+
+            // lazy matching: if a string in the tree that starts d characters later is much longer,
+            // encode only the current character, the longer string is found in one of the next iterations
+            // d+1 codes then cover d+later characters, this must beat hit characters per code
+            // the next symbol is coded in the tree of the next lane
+            Tree* later_tree = lanes.trees[(lanes.curr + 1) % lanes.n];
+            for (int d = 1; d <= opts->lazy && d < avail; d++) {
+                Node* later_node;
+                int later_probe = avail - d < probe ? avail - d : probe;
+                int later = tree_longest_prefix(later_tree, &input_str[d], later_probe, &later_node);
+                if (hit ? later + d > hit*(d+1) : later > d) {
+                    best_length = 1;
+                    node = tree_find_node(tree, input_str, 1);
+                    break;
+                }
+            }
+
             DEBUG_PRINT("length: %d\n", best_length);
+            if (opts->adaptive) {
+                probe_limit_update(&probe_limit, hit, best_length);
+            }
             
-            // get path and encode string with huffman tree
-            // if string not in tree, output nyt path 
-            if (!node) {
-                node = tree->nyt;
-                nyt = 1;
+            // with contexts, code string in the tree of the previous character if it is there
+            // else output the escape, i.e. the nyt path of the context tree, and code it with the global tree
+            Tree* context = contexts ? context_tree(contexts, prev) : NULL;
+            Node* context_node = context && node ? context_find(contexts, context, node) : NULL;
+            if (context_node) {
+                total_bits += write_code(io, context_node);
+                update_tree(context, context_node, NULL, 0);
+            } else {
+                if (context) {
+                    total_bits += write_code(io, context->nyt);
+                }
+
+                // get path and encode string with huffman tree
+                // if string not in tree, output nyt path 
+                if (!node) {
+                    node = tree->nyt;
+                    nyt = 1;
+                }
+                // first, output path from root to node
+                total_bits += write_code(io, node);
+                // then update tree
+                update_tree(tree, node, input_str, best_length);
+
+                if (context) {
+                    context_add(contexts, context, nyt ? tree_last_added(tree) : node, input_str, best_length);
+                }
             }
-            // first, get path from node to root
-            p = path_to_root(tree, node);
-            DEBUG_PRINT("path: %lu\n", p);
-            // then update tree
-            update_tree(tree, node, input_str, best_length);
-
-            // <best_length> characters encoded, "remove" them from buffer
-            chars_in_buf -= best_length;
+            prev = (uint8)input_str[best_length-1];
+
+            // <best_length> characters encoded, "remove" them from input
+            lookahead_advance(la, best_length);
             chars_encoded = best_length;
             total_encoded += chars_encoded;
 
+        } else if (lanes.n > 1) {
+            // end of file reached, the end is marked by an empty block
+            break;
+
         } else {
-            // end of file reached, output nyt + zero byte
+            // end of file reached, output nyt + zero byte, after the escape of the context
             reading = 0;    // stop reading
-            p = path_to_root(tree, tree->nyt);  // get nyt path
+            if (state) {
+                mark_stream_end(state, io);
+            }
+            if (contexts) {
+                Tree* context = context_tree(contexts, prev);
+                total_bits += write_code(io, context->nyt);
+            }
+            total_bits += write_code(io, tree->nyt);    // output nyt path
             nyt = 1; // write null byte
             chars_encoded = 0;  // write only null byte
         }
 
-        // output path
-        while (p > 1) {
-            write_bit(&io, (uint8)(p & 1));
-            p >>= 1;
-        }
+        // output length and characters of a new string
+        total_bits += nyt ? 8*(chars_encoded+1) : 0;
 
         if (nyt) {
 
@@ -127,24 +392,196 @@ void compress(int max_chars, int max_mem, FILE* inputfile, FILE* outputfile) {
 
             for (int i = 0; i <= chars_encoded; i++) {
                 // output byte
-                write_byte(&io, output_byte);
+                write_byte(io, output_byte);
                 // get next character
                 output_byte = input_str[i];
             }
         }
         DEBUG_PRINT("\n");
+        next_lane(&lanes);
+
+        // statistics of lane 0
+        if (opts->stats_file && next_stats && total_encoded >= next_stats) {
+            export_tree_stats(opts, first_tree, stats_trie, total_encoded);
+            next_stats += opts->stats_every;
+        }
     }
 
-    DEBUG_PRINT("nodes used: %d\n", tree->nodes);
-    DEBUG_PRINT("size of tree: %lu\n", tree_size(tree));
+    // final statistics, after the end of input marker
+    if (opts->stats_file) {
+        export_tree_stats(opts, first_tree, stats_trie, total_encoded);
+    }
 
-    flush(&io);
-    free_tree(tree);
-    free_trie(trie);
+    if (state) {
+        state->max_chars = opts->max_chars;
+        state->max_mem = opts->max_mem;
+        state->level = opts->level;
+        state->lazy = opts->lazy;
+        state->cost = opts->cost;
+        state->max_depth = opts->max_depth;
+        state->total_encoded = total_encoded;
+        state->total_bits = total_bits;
+    }
+
+    DEBUG_PRINT("nodes used: %d\n", first_tree->nodes);
+    DEBUG_PRINT("size of tree: %lu\n", tree_size(first_tree));
+
+    stop_analysis(analysis);
+    free_contexts(contexts);
+    finish_lanes(&lanes);
+    free_lanes(&lanes);
+    flush(out);
+}
+
+// estimate the number of bits of every string that can be encoded at this position
+// and return the length of the cheapest one, node is set to its leaf node or to NULL for a new string
+// a string in the tree costs the depth of its leaf, a new string costs the nyt path and 8 bits for the
+// length and each character, spread over the number of times the string was counted so far,
+// assuming the other occurrences get a code about as long as the nyt path
+// strings of different lengths are compared by what they save over coding the same characters at
+// <rate> bits per character, the average so far
+// new strings are only considered if counts is given, and only if longer than the longest string in the tree
+int cheapest_length(Tree* tree, const char* str, int probe, int hit, int* counts, int ladder, double rate, Node** node) {
+
+    Node* leaves[probe+1];
+    tree_prefix_leaves(tree, str, probe, leaves);
+    int nyt_depth = node_depth(tree->nyt);
+
+    int best_length = 1;
+    double best_cost = 0;
+    *node = NULL;
+    for (int len = 1; len <= probe; len++) {
+
+        double cost;
+        if (leaves[len]) {
+            cost = node_depth(leaves[len]);
+        } else if (counts && len > hit && !(ladder && (len & (len-1)))) {
+            int count = counts[len];
+            cost = (nyt_depth + 8.0*(len+1) + (count-1)*(nyt_depth+1.0)) / count;
+        } else {
+            continue;
+        }
+        cost -= len*rate;
+
+        // on a tie, prefer the longer string
+        if (len == 1 || cost <= best_cost) {
+            best_cost = cost;
+            best_length = len;
+            *node = leaves[len];
+        }
+    }
+    return best_length;
 }
 
-// returns path from node to root in huffman tree
-path path_to_root(Tree* tree, Node* node) {
+// encode rest of input with one character per leaf node, followed by the end of input marker
+// leaf nodes are found with the lookup table of the tree, the counting trie is only used for statistics
+// prev is the last character encoded before, for contexts
+// total_encoded and total_bits are increased by the characters and bits of the rest of input
+// if state is given, the position of the end of input marker is stored in it
+void encode_bytes(Lanes* lanes, Contexts* contexts, uint8 prev, Trie* trie, Lookahead* la, huffman_options* opts, unsigned long long* total_encoded, unsigned long long* total_bits, unsigned long long* next_stats, Checkpoint* state) {
+
+    int avail;
+    const char* input;
+    unsigned long long bits = 0;    // bits output, added to total_bits once per block
+    while ((input = lookahead_peek_all(la, &avail)) && avail > 0) {
+        for (int i = 0; i < avail; i++) {
+
+            Tree* tree = lanes->trees[lanes->curr];
+            huffman_io* io = lane_io(lanes);
+
+            // a run of one character is coded with the run leaf, up to the end of the block
+            if (tree->run_leaf && i + 1 < avail && input[i+1] == input[i]) {
+                size_t run = run_length(&input[i], avail - i < RLE_MAX_RUN ? avail - i : RLE_MAX_RUN);
+                if (run >= RLE_MIN_RUN) {
+                    bits += write_run(io, tree, (uint8)input[i], run);
+                    prev = (uint8)input[i];
+                    i += (int)run - 1;
+                    next_lane(lanes);
+                    continue;
+                }
+            }
+            Node* node = tree->byte_leaf[(uint8)input[i]];
+
+            // context trees have a lookup table of characters too
+            Tree* context = contexts ? context_tree(contexts, prev) : NULL;
+            Node* context_node = context ? context->byte_leaf[(uint8)input[i]] : NULL;
+            prev = (uint8)input[i];
+
+            if (context_node) {
+                bits += write_code(io, context_node);
+                update_tree(context, context_node, NULL, 0);
+                next_lane(lanes);
+                continue;
+            }
+            if (context) {
+                // escape, then code character with the global tree and add it to the context
+                bits += write_code(io, context->nyt);
+                context_add(contexts, context, NULL, &input[i], 1);
+            }
+
+            if (node) {
+                bits += write_code(io, node);
+            } else {
+                // not yet transferred, output nyt path, length 1 and the character
+                node = tree->nyt;
+                bits += write_code(io, node) + 16;
+                write_byte(io, 1);
+                write_byte(io, (uint8)input[i]);
+            }
+            update_tree(tree, node, &input[i], 1);
+            next_lane(lanes);
+        }
+        lookahead_advance(la, avail);
+        *total_encoded += avail;
+        *total_bits += bits;
+        bits = 0;
+
+        // statistics are checked once per block of input, not per character
+        if (opts->stats_file && *next_stats && *total_encoded >= *next_stats) {
+            export_tree_stats(opts, lanes->trees[0], trie, *total_encoded);
+            while (*next_stats <= *total_encoded) *next_stats += opts->stats_every;
+        }
+    }
+
+    // end of input, output nyt path + zero byte, with lanes the end is marked by an empty block
+    if (lanes->n == 1) {
+        Tree* tree = lanes->trees[0];
+        if (state) {
+            mark_stream_end(state, lanes->out);
+        }
+        if (contexts) {
+            Tree* context = context_tree(contexts, prev);
+            *total_bits += write_code(lanes->out, context->nyt);
+        }
+        *total_bits += write_code(lanes->out, tree->nyt) + 8;
+        write_byte(lanes->out, 0);
+    }
+}
+
+// output path from root to node, path is given from node to root
+// returns the number of bits written
+int write_path(huffman_io* io, path p) {
+    int bits = 0;
+    while (p > 1) {
+        write_bit(io, (uint8)(p & 1));
+        p >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+// output the code of node, i.e. the path from the root to node, returns the number of bits written
+// codes of up to MAX_CACHED_CODE bits are cached in the leaf until the tree changes above it, see cache_code
+// a longer code is collected from node up in one word, a path longer than a word is written in parts,
+// the code of the node where the word is full first, then the bits below it
+int write_code(huffman_io* io, Node* node) {
+
+    if (!node->code && !node->left) cache_code(node);
+    if (node->code && !node->left) {
+        int length = 31 - __builtin_clz(node->code);
+        write_bits(io, node->code, length);
+        return length;
+    }
 
     // initialize with 1, this way there is always a 1 in front, this eliminates the need to know the length of the path
     path p = 1;
@@ -152,8 +589,7 @@ path path_to_root(Tree* tree, Node* node) {
     // while node is not root
     while (node->parent) {
         if (p >= MAX_PATH) {
-            fprintf(stderr, "[%s:%i]exceeded maximum path length\n", __FILE__, __LINE__);
-            exit(1);
+            return write_code(io, node) + write_path(io, p);
         }
         p <<= 1;
         // if node is right child, put 1, else 0
@@ -161,18 +597,7 @@ path path_to_root(Tree* tree, Node* node) {
         node = node->parent;
     }
 
-    return p;
-}
-
-// shift string n places to the left
-void strshiftl(char* str, int length, int n) {
-    n %= length;
-    if (n <= 0) return;
-
-    // loop over string starting at position n
-    for (int i = n; i < length; i++) {
-        str[i-n] = str[i];
-    }
+    return write_path(io, p);
 }
 
 // calculate maximum number of tree nodes with respect to given memory limit and max chars per node
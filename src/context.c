@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <string.h>
+#include "context.h"
+#include "huffman_util.h"
+#include "arena.h"
+
+#define CONTEXT_HASH 0x9d   // odd, so multiplying permutes the characters
+#define CONTEXT_TABLE_SIZE 1024     // initial size of the table of context leaves
+
+// internal functions
+size_t entry_index(Contexts* contexts, Tree* tree, Node* global_leaf);
+void grow_table(Contexts* contexts);
+void clear_contexts(Contexts* contexts);
+
+
+// initialize <classes> empty contexts, classes must be a power of 2
+Contexts* init_contexts(int classes, int max_nodes) {
+    Contexts* contexts = (Contexts*)safe_calloc(1, sizeof(Contexts));   // calloc sets trees to NULL
+    contexts->classes = classes;
+    contexts->shift = 8;
+    while ((1 << (8 - contexts->shift)) < classes) contexts->shift--;
+    contexts->arena = init_arena();
+    contexts->max_nodes = max_nodes;
+    contexts->table_size = CONTEXT_TABLE_SIZE;
+    contexts->table = (Context_entry*)safe_calloc(contexts->table_size, sizeof(Context_entry));
+    return contexts;
+}
+
+// returns tree of the context after character prev, the tree is created on first use
+Tree* context_tree(Contexts* contexts, unsigned char prev) {
+    int class = (uint8_t)(prev * CONTEXT_HASH) >> contexts->shift;
+    if (!contexts->trees[class]) {
+        contexts->trees[class] = init_context_tree(contexts->arena);
+        set_max_depth(contexts->trees[class], contexts->max_depth);
+    }
+    return contexts->trees[class];
+}
+
+// returns leaf in context tree with the string of a leaf in the global tree, NULL if the context has no such leaf
+Node* context_find(Contexts* contexts, Tree* tree, Node* global_leaf) {
+    Context_entry* entry = &contexts->table[entry_index(contexts, tree, global_leaf)];
+    return entry->tree ? entry->leaf : NULL;
+}
+
+// add string to context tree
+// global_leaf is the leaf of the string in the global tree, the encoder needs it to find the new leaf again
+// the decoder does not look up leaves and passes NULL
+// when the context trees are full, they are all removed, so tree must not be used after this
+void context_add(Contexts* contexts, Tree* tree, Node* global_leaf, const char* str, int length) {
+
+    update_tree(tree, tree->nyt, str, length);
+    contexts->nodes += 2;
+
+    if (global_leaf) {
+        if (2 * (contexts->entries + 1) > contexts->table_size) {
+            grow_table(contexts);
+        }
+        Context_entry* entry = &contexts->table[entry_index(contexts, tree, global_leaf)];
+        entry->tree = tree;
+        entry->global_leaf = global_leaf;
+        entry->leaf = tree_last_added(tree);
+        contexts->entries++;
+    }
+
+    // full context trees have long escapes, start again with empty ones
+    if (contexts->nodes >= contexts->max_nodes) {
+        clear_contexts(contexts);
+    }
+}
+
+// remove all context trees, memory of the nodes is kept for reuse
+void clear_contexts(Contexts* contexts) {
+    for (int i = 0; i < CONTEXT_MAX_CLASSES; i++) {
+        free_tree(contexts->trees[i]);
+        contexts->trees[i] = NULL;
+    }
+    reset_arena(contexts->arena);
+    memset(contexts->table, 0, contexts->table_size * sizeof(Context_entry));
+    contexts->entries = 0;
+    contexts->nodes = 0;
+}
+
+// returns index of the entry with the given key, or of the empty entry where it belongs
+size_t entry_index(Contexts* contexts, Tree* tree, Node* global_leaf) {
+    size_t mask = contexts->table_size - 1;
+    uint64_t hash = ((uintptr_t)global_leaf ^ (uintptr_t)tree) * 0x9e3779b97f4a7c15ULL;
+    size_t i = (size_t)(hash >> 32) & mask;
+    while (contexts->table[i].tree && (contexts->table[i].tree != tree || contexts->table[i].global_leaf != global_leaf)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// double size of table and insert all entries again
+void grow_table(Contexts* contexts) {
+    Context_entry* old = contexts->table;
+    size_t old_size = contexts->table_size;
+
+    contexts->table_size *= 2;
+    contexts->table = (Context_entry*)safe_calloc(contexts->table_size, sizeof(Context_entry));
+    for (size_t i = 0; i < old_size; i++) {
+        if (old[i].tree) {
+            contexts->table[entry_index(contexts, old[i].tree, old[i].global_leaf)] = old[i];
+        }
+    }
+    free(old);
+}
+
+// free all context trees and their memory
+void free_contexts(Contexts* contexts) {
+    if (!contexts) return;
+    for (int i = 0; i < CONTEXT_MAX_CLASSES; i++) {
+        free_tree(contexts->trees[i]);
+    }
+    free_arena(contexts->arena);
+    free(contexts->table);
+    free(contexts);
+}
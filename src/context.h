@@ -0,0 +1,46 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "huffman.h"
+
+#define CONTEXT_MAX_CLASSES 256
+
+// entry in the table of context leaves, key is a context tree and a leaf of the global tree
+typedef struct Context_entry {
+    Tree* tree;
+    Node* global_leaf;
+    Node* leaf;     // leaf with the same string in the context tree
+} Context_entry;
+
+// order-1 contexts: the previous character selects a small adaptive tree that is tried before the global tree
+// a string not in the context tree is coded by the nyt path of the context tree (the escape),
+// followed by its code in the global tree, and is then added to the context tree
+// characters are hashed to <classes> classes, each class has its own tree
+// every string in a context tree is also in the global tree, the encoder finds context leaves
+// by the global leaf with the same string
+typedef struct Contexts {
+
+    int classes;    // power of 2, at most CONTEXT_MAX_CLASSES
+    int shift;      // class of character c is (c * CONTEXT_HASH & 0xff) >> shift
+
+    Tree* trees[CONTEXT_MAX_CLASSES];   // NULL until the class is first used
+    Arena* arena;   // nodes and strings of all context trees
+
+    int nodes;      // number of nodes in all context trees
+    int max_nodes;  // all context trees are removed when nodes reaches this
+    int max_depth;  // bound on the depth of the context trees, 0 for none
+
+    // open addressing hash table of context leaves, only used by the encoder
+    Context_entry* table;
+    size_t table_size;  // power of 2
+    size_t entries;
+
+} Contexts;
+
+Contexts* init_contexts(int classes, int max_nodes);
+Tree* context_tree(Contexts* contexts, unsigned char prev);
+Node* context_find(Contexts* contexts, Tree* tree, Node* global_leaf);
+void context_add(Contexts* contexts, Tree* tree, Node* global_leaf, const char* str, int length);
+void free_contexts(Contexts* contexts);
+
+#endif // CONTEXT_H
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "daemon.h"
+#include "huffman_util.h"
+#include "trie.h"
+#include "dict.h"
+#include "lanes.h"
+#include "tune.h"
+
+// internal functions
+void* daemon_worker(void* arg);
+void serve_request(Daemon* daemon, int fd, Tree* tree, Trie* trie);
+int parse_request(Daemon* daemon, const unsigned char* request, huffman_options* opts);
+void send_response(int fd, int status, const char* data, unsigned long long len);
+int open_socket(const char* path, struct sockaddr_un* addr);
+int read_full(int fd, void* buf, size_t n);
+int read_payload(int fd, unsigned long long len, char** payload);
+int write_full(int fd, const void* buf, size_t n);
+void put_u64(unsigned char* buf, unsigned long long value);
+unsigned long long get_u64(const unsigned char* buf);
+
+
+// listen on a unix domain socket at path and serve requests with <workers> threads
+// a file left at path by an earlier daemon is removed first
+// only returns if the socket could not be opened, returns 1
+int run_daemon(huffman_options* opts, const char* path, int workers) {
+
+    struct sockaddr_un addr;
+    Daemon daemon;
+    daemon.opts = opts;
+    daemon.socket = open_socket(path, &addr);
+    if (daemon.socket < 0) return 1;
+
+    unlink(path);
+    if (bind(daemon.socket, (struct sockaddr*)&addr, sizeof(addr)) || listen(daemon.socket, SOMAXCONN)) {
+        fprintf(stderr, "Error: could not listen on %s\n", path);
+        close(daemon.socket);
+        return 1;
+    }
+    // a client that disconnects early must not stop the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_t threads[workers];
+    for (int w = 0; w < workers; w++) {
+        if (pthread_create(&threads[w], NULL, daemon_worker, &daemon)) {
+            fprintf(stderr, "[%s:%i] could not start worker thread\n", __FILE__, __LINE__);
+            exit(1);
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    return 1;
+}
+
+// worker thread, accepts connections until the socket is closed
+void* daemon_worker(void* arg) {
+    Daemon* daemon = (Daemon*)arg;
+
+    Tree* tree = init_tree();
+    Trie* trie = init_trie();
+
+    while (1) {
+        int fd = accept(daemon->socket, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        struct timeval timeout = {DAEMON_TIMEOUT, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        serve_request(daemon, fd, tree, trie);
+        close(fd);
+    }
+
+    free_tree(tree);
+    free_trie(trie);
+    return NULL;
+}
+
+// read one request from fd, compress or decompress its payload in memory and send the result
+void serve_request(Daemon* daemon, int fd, Tree* tree, Trie* trie) {
+
+    unsigned char request[DAEMON_REQUEST_SIZE + 8];
+    if (read_full(fd, request, sizeof(request))) return;
+
+    huffman_options opts;
+    unsigned long long len = get_u64(&request[DAEMON_REQUEST_SIZE]);
+    if (parse_request(daemon, request, &opts) || len > DAEMON_MAX_PAYLOAD) {
+        const char* msg = "invalid request";
+        send_response(fd, 1, msg, strlen(msg));
+        return;
+    }
+
+    char* payload = NULL;
+    int result = read_payload(fd, len, &payload);
+    if (result) {
+        if (result > 0) {
+            const char* msg = "out of memory";
+            send_response(fd, 1, msg, strlen(msg));
+        }
+        free(payload);
+        return;
+    }
+
+    // the payload is compressed where it is, without a copy, and its size is stored in the header
+    char* output = NULL;
+    size_t output_len = 0;
+    FILE* outputfile = open_memstream(&output, &output_len);
+    if (!outputfile) {
+        fprintf(stderr, "[%s:%i] could not open memory stream\n", __FILE__, __LINE__);
+        exit(1);
+    }
+
+    int failed = 0;
+    if (request[0] == 'c') {
+        compress_memory(tree, trie, &opts, payload, len, outputfile);
+    } else {
+        FILE* inputfile = fmemopen(payload, len, "rb");
+        if (!inputfile) {
+            fprintf(stderr, "[%s:%i] could not open memory stream\n", __FILE__, __LINE__);
+            exit(1);
+        }
+        failed = decompress_tree(tree, &opts, inputfile, outputfile);
+        fclose(inputfile);
+    }
+    fclose(outputfile);
+
+    if (failed) {
+        const char* msg = "input is not a valid compressed stream for this daemon";
+        send_response(fd, 1, msg, strlen(msg));
+    } else {
+        send_response(fd, 0, output, output_len);
+    }
+    free(output);
+    free(payload);
+}
+
+// set options from a request, with the memory limit and dictionary of the daemon
+// returns 0 if the request is valid, else -1
+int parse_request(Daemon* daemon, const unsigned char* request, huffman_options* opts) {
+
+    *opts = init_options();
+    opts->mem_limit = daemon->opts->mem_limit;
+
+    char op = (char)request[0];
+    opts->max_chars = request[1];
+    opts->max_mem = request[2];
+    opts->level = request[3];
+    opts->lazy = request[4];
+    opts->lanes = request[5];
+    opts->contexts = request[6] ? 1 << (request[6] - 1) : 0;
+    opts->objective = request[7];
+    opts->cost = request[8] & DAEMON_FLAG_COST;
+    opts->adaptive = (request[8] & DAEMON_FLAG_ADAPTIVE) != 0;
+    unsigned int dict_id = request[9] | request[10] << 8 | request[11] << 16 | (unsigned int)request[12] << 24;
+    opts->max_depth = request[13];
+
+    if (op != 'c' && op != 'd') return -1;
+    if (op == 'd') {
+        // decompression takes everything from the stream header, the dictionary is checked there
+        opts->dict = daemon->opts->dict;
+        return 0;
+    }
+    if (request[8] & DAEMON_FLAG_DICT) {
+        if (!daemon->opts->dict || daemon->opts->dict->id != dict_id) return -1;
+        opts->dict = daemon->opts->dict;
+    }
+    if (opts->max_mem > 9 || opts->level < 1 || opts->level > 9 || opts->lazy > 2) return -1;
+    if (opts->lanes < 1 || opts->lanes > LANES_MAX || request[6] > 9 || (opts->contexts && opts->lanes > 1)) return -1;
+    if (opts->objective < TUNE_BALANCED || opts->objective > TUNE_RATIO) return -1;
+    if (opts->max_depth && (opts->max_depth < MIN_MAX_DEPTH || opts->max_depth > MAX_MAX_DEPTH)) return -1;
+    return 0;
+}
+
+void send_response(int fd, int status, const char* data, unsigned long long len) {
+    unsigned char response[9];
+    response[0] = (unsigned char)status;
+    put_u64(&response[1], len);
+    if (!write_full(fd, response, sizeof(response))) {
+        write_full(fd, data, len);
+    }
+}
+
+// send input to the daemon at path and write the result to the output file
+// op is 'c' or 'd', for compression the options are sent with the request
+// returns 0 on success, 1 if the daemon could not be reached or the request failed
+int run_client(huffman_options* opts, const char* path, char op, FILE* inputfile, FILE* outputfile) {
+
+    struct sockaddr_un addr;
+    int fd = open_socket(path, &addr);
+    if (fd < 0) return 1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        fprintf(stderr, "Error: could not connect to %s\n", path);
+        close(fd);
+        return 1;
+    }
+
+    size_t len;
+    char* input = read_all(inputfile, &len);
+
+    int log2_contexts = 0;
+    while (opts->contexts >> log2_contexts) log2_contexts++;   // log2 + 1, 0 for no contexts
+    unsigned int dict_id = opts->dict ? opts->dict->id : 0;
+
+    unsigned char request[DAEMON_REQUEST_SIZE + 8];
+    request[0] = (unsigned char)op;
+    request[1] = (unsigned char)opts->max_chars;
+    request[2] = (unsigned char)opts->max_mem;
+    request[3] = (unsigned char)opts->level;
+    request[4] = (unsigned char)opts->lazy;
+    request[5] = (unsigned char)opts->lanes;
+    request[6] = (unsigned char)log2_contexts;
+    request[7] = (unsigned char)opts->objective;
+    request[8] = (opts->cost ? DAEMON_FLAG_COST : 0) | (opts->dict ? DAEMON_FLAG_DICT : 0) | (opts->adaptive ? DAEMON_FLAG_ADAPTIVE : 0);
+    for (int i = 0; i < 4; i++) {
+        request[9+i] = (unsigned char)(dict_id >> 8*i);
+    }
+    request[13] = (unsigned char)opts->max_depth;
+    put_u64(&request[DAEMON_REQUEST_SIZE], len);
+
+    // the daemon answers a rejected request without reading the payload, so read the response even if sending failed
+    signal(SIGPIPE, SIG_IGN);
+    if (!write_full(fd, request, sizeof(request))) {
+        write_full(fd, input, len);
+    }
+    free(input);
+    unsigned char response[9];
+    if (read_full(fd, response, sizeof(response))) {
+        fprintf(stderr, "Error: no response from %s\n", path);
+        close(fd);
+        return 1;
+    }
+
+    // copy payload to output
+    unsigned long long left = get_u64(&response[1]);
+    char buf[1 << 16];
+    while (left > 0) {
+        size_t n = left < sizeof(buf) ? left : sizeof(buf);
+        if (read_full(fd, buf, n)) {
+            fprintf(stderr, "Error: incomplete response from %s\n", path);
+            close(fd);
+            return 1;
+        }
+        fwrite(buf, 1, n, response[0] ? stderr : outputfile);
+        left -= n;
+    }
+    close(fd);
+
+    if (response[0]) {
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    return 0;
+}
+
+// create socket and address for path, returns -1 if the path is too long or there is no socket
+int open_socket(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Error: socket path is too long\n");
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: could not create socket\n");
+    }
+    return fd;
+}
+
+// read exactly n bytes, returns 0 if ok, -1 on end of stream, error or timeout
+int read_full(int fd, void* buf, size_t n) {
+    char* p = (char*)buf;
+    while (n > 0) {
+        ssize_t k = read(fd, p, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return -1;
+        p += k;
+        n -= k;
+    }
+    return 0;
+}
+
+// read a payload of len bytes into a new buffer, which grows as the bytes arrive, so a client can not make
+// the daemon allocate more memory than it sends
+// returns 0 if ok, -1 on end of stream, error or timeout, 1 if the buffer could not be allocated
+int read_payload(int fd, unsigned long long len, char** payload) {
+    size_t size = 0;
+    size_t done = 0;
+    *payload = NULL;
+    do {
+        size_t next = size ? 2 * size : DAEMON_PAYLOAD_BLOCK;
+        if (next > len) next = len ? len : 1;
+        char* buf = (char*)realloc(*payload, next);
+        if (!buf) return 1;
+        *payload = buf;
+        size = next;
+        size_t n = (len < size ? len : size) - done;
+        if (read_full(fd, &buf[done], n)) return -1;
+        done += n;
+    } while (done < len);
+    return 0;
+}
+
+// write exactly n bytes, returns 0 if ok, -1 on error
+int write_full(int fd, const void* buf, size_t n) {
+    const char* p = (const char*)buf;
+    while (n > 0) {
+        ssize_t k = write(fd, p, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return -1;
+        p += k;
+        n -= k;
+    }
+    return 0;
+}
+
+void put_u64(unsigned char* buf, unsigned long long value) {
+    for (int i = 0; i < 8; i++) {
+        buf[i] = (unsigned char)(value >> 8*i);
+    }
+}
+
+unsigned long long get_u64(const unsigned char* buf) {
+    unsigned long long value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (unsigned long long)buf[i] << 8*i;
+    }
+    return value;
+}
+
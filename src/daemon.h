@@ -0,0 +1,32 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "huffman.h"
+
+// protocol between client and daemon, one request per connection
+// request: DAEMON_REQUEST_SIZE bytes, payload length (8 bytes, little endian), payload
+//   op ('c' compress, 'd' decompress), LEN (0 for auto), MEM, level, lazy, lanes,
+//   log2 of context classes plus 1 (0 for none), objective, flags, dictionary id (4 bytes, little endian), max depth
+// response: status (0 ok, 1 failed), payload length (8 bytes, little endian), payload
+//   the payload is the output, or an error message if the request failed
+#define DAEMON_REQUEST_SIZE 14
+#define DAEMON_FLAG_COST 0x01   // -s
+#define DAEMON_FLAG_DICT 0x02   // compress with the dictionary of the daemon, its id must match
+#define DAEMON_FLAG_ADAPTIVE 0x04   // -e
+#define DAEMON_MAX_PAYLOAD (1ULL << 30)
+#define DAEMON_PAYLOAD_BLOCK (1 << 16)  // first size of the payload buffer, it doubles as the payload arrives
+#define DAEMON_TIMEOUT 10       // seconds a worker waits for a slow client
+
+// daemon that serves compress and decompress requests on a unix domain socket
+// every worker thread keeps its tree and counting trie, so requests start without allocations
+typedef struct Daemon {
+    int socket;
+    huffman_options* opts;  // memory limit and dictionary for all requests
+} Daemon;
+
+int run_daemon(huffman_options* opts, const char* path, int workers);
+int run_client(huffman_options* opts, const char* path, char op, FILE* inputfile, FILE* outputfile);
+
+#endif // DAEMON_H
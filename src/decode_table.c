@@ -0,0 +1,62 @@
+#include "decode_table.h"
+#include "huffman_util.h"
+
+// internal functions
+void build_decode_table(Decode_table* table, Node* node, int depth, unsigned int prefix);
+
+
+// create an empty table, it is built when it is first used
+Decode_table* init_decode_table() {
+    Decode_table* table = (Decode_table*)safe_calloc(1, sizeof(Decode_table));
+    table->dirty = 1;
+    return table;
+}
+
+// mark the table of tree dirty if node is at most DECODE_BITS below the root
+// called before node is swapped or replaced, nodes deeper than that are not in the table
+void decode_table_touch(Tree* tree, Node* node) {
+    Decode_table* table = tree->decode;
+    if (!table || table->dirty) return;
+    for (int depth = 0; depth <= DECODE_BITS; depth++) {
+        if (!node->parent) {
+            table->dirty = 1;
+            table->misses = 0;
+            return;
+        }
+        node = node->parent;
+    }
+}
+
+// fill the entries of all bit values that start with the code of node, prefix is its code of depth bits
+void build_decode_table(Decode_table* table, Node* node, int depth, unsigned int prefix) {
+    if (node->left && depth < DECODE_BITS) {
+        build_decode_table(table, node->left, depth + 1, prefix << 1);
+        build_decode_table(table, node->right, depth + 1, prefix << 1 | 1);
+        return;
+    }
+    int free_bits = DECODE_BITS - depth;
+    for (unsigned int i = prefix << free_bits; i < (prefix + 1) << free_bits; i++) {
+        table->entries[i].node = node;
+        table->entries[i].length = depth;
+    }
+}
+
+// read the first bits of the next code with the table of tree and return the node they lead to
+// the caller continues bit by bit from there until a leaf is reached
+// returns the root without reading if tree has no table, the table is dirty or not enough bits are buffered
+Node* decode_prefix(Tree* tree, huffman_io* io) {
+    Decode_table* table = tree->decode;
+    if (!table) return tree->root;
+
+    if (table->dirty) {
+        if (++table->misses < DECODE_REBUILD) return tree->root;
+        build_decode_table(table, tree->root, 0, 0);
+        table->dirty = 0;
+    }
+
+    unsigned int bits;
+    if (!peek_bits(io, DECODE_BITS, &bits)) return tree->root;
+    Decode_entry* entry = &table->entries[bits];
+    skip_bits(io, entry->length);
+    return entry->node;
+}
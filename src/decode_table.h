@@ -0,0 +1,32 @@
+#ifndef DECODE_TABLE_H
+#define DECODE_TABLE_H
+
+#include "huffman.h"
+#include "huffman_io.h"
+
+#define DECODE_BITS 8       // number of bits looked up at once
+#define DECODE_REBUILD 16   // symbols decoded without the table after it became dirty, before it is rebuilt
+
+// entry for one value of the next DECODE_BITS bits of input
+typedef struct Decode_entry {
+    Node* node;     // leaf whose code is a prefix of the bits, or the node reached after all bits
+    int length;     // number of bits from the root to node
+} Decode_entry;
+
+// lookup table for the top DECODE_BITS levels of the tree of a decoder
+// these change much less often than the levels below, so the table is only rebuilt when a node
+// within DECODE_BITS of the root is swapped or replaced, and not before DECODE_REBUILD symbols
+// were decoded bit by bit since, so a rebuild costs at most as much as the symbols it waited for
+typedef struct Decode_table {
+
+    Decode_entry entries[1 << DECODE_BITS];
+    int dirty;      // tree changed within DECODE_BITS of the root since the last rebuild
+    int misses;     // symbols decoded since the table became dirty
+
+} Decode_table;
+
+Decode_table* init_decode_table();
+void decode_table_touch(Tree* tree, Node* node);
+Node* decode_prefix(Tree* tree, huffman_io* io);
+
+#endif // DECODE_TABLE_H
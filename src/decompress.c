@@ -3,23 +3,189 @@
 #include <string.h>
 #include "huffman.h"
 #include "huffman_io.h"
+#include "arena.h"
+#include "header.h"
+#include "stats.h"
+#include "lanes.h"
+#include "context.h"
+#include "dict.h"
+#include "checkpoint.h"
+#include "decode_table.h"
+#include "dedup.h"
+#include "lz77.h"
+#include "rle.h"
+
+// internal functions
+unsigned long long decode_strings(Tree* tree, huffman_io* io, huffman_io* out, huffman_options* opts, int* corrupted);
+unsigned long long decode_bytes(Tree* tree, huffman_io* io, huffman_io* out, huffman_options* opts, int* corrupted);
+unsigned long long decode_lanes(Lanes* lanes, huffman_io* out, huffman_options* opts, int* corrupted);
+unsigned long long emit_symbol(Tree* tree, Node* node, huffman_io* io, huffman_io* out);
+unsigned long long decode_contexts(Tree* tree, Contexts* contexts, huffman_io* io, huffman_io* out, huffman_options* opts);
+void reserve_tree_memory(Tree* tree, Header* header);
 
 // decompress an input file encoded by huffman coding
-void decompress(FILE* inputfile, FILE* outputfile) {
+void decompress(huffman_options* opts, FILE* inputfile, FILE* outputfile) {
 
     Tree* tree = init_tree();
-    huffman_io io = init_io(inputfile, READ);
+    int failed = decompress_tree(tree, opts, inputfile, outputfile);
+    free_tree(tree);
+
+    if (failed) exit(1);
+}
+
+// decompress an input file with a given huffman tree, the tree is reset first
+// this way its memory can be reused for multiple files
+// returns 0 on success, -1 if the input is not a valid stream or cannot be decoded under the options
+int decompress_tree(Tree* tree, huffman_options* opts, FILE* inputfile, FILE* outputfile) {
+
+    if (!tree->decode) tree->decode = init_decode_table();
+    reset_tree(tree);
+    huffman_io io = opts->pipelined ? init_pipelined_io(inputfile, READ) : init_io(inputfile, READ);
+    huffman_io out = opts->pipelined ? init_pipelined_io(outputfile, WRITE) : init_io(outputfile, WRITE);
+
+    Header header;
+    int failed = 0;
+    if (read_header(&io, &header)) {
+        fprintf(stderr, "Error: input is not a compressed file\n");
+        failed = 1;
+    // the encoder limits the size of the tree with MEM, so MEM bounds the memory needed to decode
+    } else if (opts->mem_limit >= 0 && MEM_LIMIT[header.max_mem] > MEM_LIMIT[opts->mem_limit]) {
+        fprintf(stderr, "Error: input needs up to %i bytes of memory, limit is %i bytes\n", MEM_LIMIT[header.max_mem], MEM_LIMIT[opts->mem_limit]);
+        failed = 1;
+    // the LZ77 engine keeps twice its window of output
+    } else if (opts->mem_limit >= 0 && (header.flags & HEADER_HAS_WINDOW) && (2 << header.window) > MEM_LIMIT[opts->mem_limit]) {
+        fprintf(stderr, "Error: input needs up to %i bytes of memory, limit is %i bytes\n", 2 << header.window, MEM_LIMIT[opts->mem_limit]);
+        failed = 1;
+    } else if ((header.flags & HEADER_HAS_DICT) && !opts->checkpoint && (!opts->dict || opts->dict->id != header.dict_id)) {
+        fprintf(stderr, "Error: input was compressed with dictionary %08x\n", header.dict_id);
+        failed = 1;
+    }
+    if (failed) {
+        close_io(&out);
+        close_io(&io);
+        return -1;
+    }
+    reserve_tree_memory(tree, &header);
+    set_max_depth(tree, header.max_depth);
+
+    // to resume, the tree of the checkpoint replaces the tree primed with the dictionary,
+    // and only the symbols after its end of input marker are decoded
+    Checkpoint state;
+    if (opts->checkpoint && (header.lanes > 1 || header.contexts || (header.flags & (HEADER_HAS_DEDUP | HEADER_HAS_RUNS)) || header.engine == ENGINE_LZ77)) {
+        fprintf(stderr, "Error: cannot resume a stream with lanes, contexts, chunks, runs or matches\n");
+        failed = 1;
+    } else if (opts->checkpoint && load_checkpoint(opts->checkpoint, &state, tree, NULL)) {
+        fprintf(stderr, "Error: could not read checkpoint %s\n", opts->checkpoint);
+        failed = 1;
+    } else if (opts->checkpoint && resume_input(&io, &state)) {
+        fprintf(stderr, "Error: input does not continue after checkpoint %s\n", opts->checkpoint);
+        failed = 1;
+    }
+    if (failed) {
+        close_io(&out);
+        close_io(&io);
+        return -1;
+    }
+
+    // the run leaf is added before the dictionary, as by the encoder
+    if (header.flags & HEADER_HAS_RUNS) {
+        add_run_leaf(tree);
+    }
+
+    // with dedup, the distinct chunks are decoded in memory, and written in the order of the list of chunks at the end
+    huffman_io unique;
+    huffman_io* dst = &out;
+    if (header.flags & HEADER_HAS_DEDUP) {
+        unique = init_memory_io();
+        dst = &unique;
+    }
+
+    unsigned long long decoded;
+    int corrupted = 0;
+    if (header.lanes > 1) {
+        Lanes lanes;
+        init_lanes(&lanes, header.lanes, tree, &io);
+        for (int i = 0; i < lanes.n; i++) {
+            if (i > 0) {
+                reserve_tree_memory(lanes.trees[i], &header);
+                lanes.trees[i]->decode = init_decode_table();
+            }
+            set_max_depth(lanes.trees[i], header.max_depth);
+            if (header.flags & HEADER_HAS_DICT) prime_tree(lanes.trees[i], opts->dict, header.max_chars);
+        }
+        decoded = decode_lanes(&lanes, dst, opts, &corrupted);
+        free_lanes(&lanes);
+    } else {
+        if ((header.flags & HEADER_HAS_DICT) && !opts->checkpoint) {
+            prime_tree(tree, opts->dict, header.max_chars);
+        }
+        if (header.engine == ENGINE_LZ77) {
+            decoded = decode_lz77(tree, &header, &io, dst, opts, &corrupted);
+        } else if (header.contexts) {
+            int max_nodes = bounded_tree_nodes(calc_max_tree_nodes(header.max_mem, header.max_chars) / 2, header.max_depth);
+            Contexts* contexts = init_contexts(header.contexts, max_nodes);
+            contexts->max_depth = header.max_depth;
+            decoded = decode_contexts(tree, contexts, &io, dst, opts);
+            free_contexts(contexts);
+        } else if (header.engine == ENGINE_BYTES) {
+            decoded = decode_bytes(tree, &io, dst, opts, &corrupted);
+        } else {
+            decoded = decode_strings(tree, &io, dst, opts, &corrupted);
+        }
+    }
+    if (dst != &out) {
+        corrupted = corrupted || restore_chunks(&io, &unique, &out, &decoded);
+        close_io(&unique);
+    }
+    if (opts->stats_file) {
+        export_tree_stats(opts, tree, NULL, decoded);
+    }
+
+    close_io(&out);
+    close_io(&io);
+
+    if (corrupted) {
+        fprintf(stderr, "Error: input is corrupted\n");
+        return -1;
+    }
+    if ((header.flags & HEADER_HAS_SIZE) && decoded != header.original_size) {
+        fprintf(stderr, "Error: decompressed %llu bytes, expected %llu bytes\n", decoded, header.original_size);
+        return -1;
+    }
+    return 0;
+}
+
+// allocate memory for all tree nodes the stream can create at once
+// with lanes, this is the memory of the tree of one lane, with contexts the memory of the global tree
+void reserve_tree_memory(Tree* tree, Header* header) {
+
+    // the encoder stops adding strings at max tree nodes, after that only single characters are added
+    unsigned long long nodes = calc_max_tree_nodes(header->max_mem, header->max_chars) / header->lanes / (header->contexts ? 2 : 1) + 2*256;
+    unsigned long long node_size = sizeof(Node) + header->max_chars/2 + 8;  // node and average string
+    // every leaf node is added for at least one character of input
+    if ((header->flags & HEADER_HAS_SIZE) && 2*header->original_size + 1 < nodes) {
+        nodes = 2*header->original_size + 1;
+    }
+    arena_reserve(tree->arena, nodes * node_size);
+}
+
+// decode stream with leaf nodes of any length, returns number of characters decoded
+// sets corrupted if a run is invalid
+unsigned long long decode_strings(Tree* tree, huffman_io* io, huffman_io* out, huffman_options* opts, int* corrupted) {
+
+    unsigned long long decoded = 0;
+    unsigned long long next_stats = opts->stats_every;
 
     // read input bit by bit
     uint8 bit;
-    while (!io.eof_reached) {
+    while (!io->eof_reached) {
         
-        // search node in tree via path
-        Node* node = tree->root;
+        // search node in tree via path, the first bits at once
+        Node* node = decode_prefix(tree, io);
         // while node is not a leaf
         while (node->left && node->right) {
             // read next bit
-            bit = read_bit(&io);
+            bit = read_bit(io);
             // next node is child of node
             node = bit ? node->right : node->left;  // if bit is 1, take right path, if bit is 0, take left path
         }
@@ -28,11 +194,11 @@ void decompress(FILE* inputfile, FILE* outputfile) {
         if (node == tree->nyt) {
 
             // first read length in bytes
-            uint8 length = read_byte(&io);
+            uint8 length = read_byte(io);
 
             // if length is 0, this is the last character, stop reading
             if (length == 0) {
-                io.eof_reached = 1;
+                io->eof_reached = 1;
                 break;
             }
 
@@ -41,20 +207,237 @@ void decompress(FILE* inputfile, FILE* outputfile) {
             str[length] = '\0';
             for (int i = 0; i < length; i++) {
 
-                uint8 c = read_byte(&io);
+                uint8 c = read_byte(io);
 
-                // write character back to output 
-                fputc(c, outputfile);
                 str[i] = c;
             }
+            // write characters back to output
+            write_bytes(out, str, length);
             update_tree(tree, node, str, length);
+            decoded += length;
+
+        } else if (node->strlength == 1) {
+            // single character, skip the copy loop of write_bytes
+            io_putc(out, (uint8)node->string[0]);
+            update_tree(tree, node, NULL, 0);
+            decoded++;
+
+        } else if (node == tree->run_leaf) {
+            // run of one character, see rle.h
+            size_t length = read_run(io, out);
+            if (!length) {
+                *corrupted = 1;
+                break;
+            }
+            update_tree(tree, node, NULL, 0);
+            decoded += length;
 
         } else {
             // write characters of leaf node to output
-            fwrite(node->string, sizeof(char), node->strlength, outputfile);
+            write_bytes(out, node->string, node->strlength);
             update_tree(tree, node, NULL, 0);
+            decoded += node->strlength;
+        }
+
+        if (opts->stats_file && next_stats && decoded >= next_stats) {
+            export_tree_stats(opts, tree, NULL, decoded);
+            next_stats += opts->stats_every;
         }
     }
 
-    free_tree(tree);
+    return decoded;
+}
+
+// decode stream with single character leaf nodes only, returns number of characters decoded
+// sets corrupted if a run is invalid
+unsigned long long decode_bytes(Tree* tree, huffman_io* io, huffman_io* out, huffman_options* opts, int* corrupted) {
+
+    unsigned long long decoded = 0;
+    unsigned long long next_stats = opts->stats_every;
+
+    while (!io->eof_reached) {
+
+        // search leaf node in tree via path, the first bits at once
+        Node* node = decode_prefix(tree, io);
+        while (node->left) {
+            node = read_bit(io) ? node->right : node->left;
+        }
+
+        if (node == tree->nyt) {
+            // length is 1 for a new character, 0 at end of input
+            if (read_byte(io) == 0) break;
+            char c = (char)read_byte(io);
+            io_putc(out, (uint8)c);
+            update_tree(tree, node, &c, 1);
+            decoded++;
+        } else if (node == tree->run_leaf) {
+            size_t length = read_run(io, out);
+            if (!length) {
+                *corrupted = 1;
+                break;
+            }
+            update_tree(tree, node, NULL, 0);
+            decoded += length;
+        } else {
+            io_putc(out, (uint8)node->string[0]);
+            update_tree(tree, node, NULL, 0);
+            decoded++;
+        }
+
+        if (opts->stats_file && next_stats && decoded >= next_stats) {
+            export_tree_stats(opts, tree, NULL, decoded);
+            next_stats += opts->stats_every;
+        }
+    }
+
+    return decoded;
+}
+
+// decode stream with symbols assigned round robin to lanes, returns number of characters decoded
+// in each round the trees of all lanes are walked at once, so the loads of the independent walks overlap
+// sets corrupted if a lane has a new string of length 0
+unsigned long long decode_lanes(Lanes* lanes, huffman_io* out, huffman_options* opts, int* corrupted) {
+
+    unsigned long long decoded = 0;
+    unsigned long long next_stats = opts->stats_every;
+    int n = lanes->n;
+
+    unsigned int symbols;
+    while ((symbols = read_lanes_block(lanes)) > 0) {
+
+        // full rounds, one symbol of every lane
+        for (; symbols >= (unsigned int)n; symbols -= n) {
+            Node* nodes[LANES_MAX];
+            for (int i = 0; i < n; i++) {
+                nodes[i] = decode_prefix(lanes->trees[i], &lanes->ios[i]);
+            }
+            int walking = 1;
+            while (walking) {
+                walking = 0;
+                for (int i = 0; i < n; i++) {
+                    if (nodes[i]->left) {
+                        nodes[i] = read_bit(&lanes->ios[i]) ? nodes[i]->right : nodes[i]->left;
+                        walking = 1;
+                    }
+                }
+            }
+            // symbols are written in lane order
+            for (int i = 0; i < n; i++) {
+                unsigned long long length = emit_symbol(lanes->trees[i], nodes[i], &lanes->ios[i], out);
+                if (!length) {
+                    *corrupted = 1;
+                    return decoded;
+                }
+                decoded += length;
+            }
+        }
+
+        // last round of the stream may be incomplete
+        for (int i = 0; i < (int)symbols; i++) {
+            Node* node = decode_prefix(lanes->trees[i], &lanes->ios[i]);
+            while (node->left) {
+                node = read_bit(&lanes->ios[i]) ? node->right : node->left;
+            }
+            unsigned long long length = emit_symbol(lanes->trees[i], node, &lanes->ios[i], out);
+            if (!length) {
+                *corrupted = 1;
+                return decoded;
+            }
+            decoded += length;
+        }
+
+        // statistics of lane 0, once per block
+        if (opts->stats_file && next_stats && decoded >= next_stats) {
+            export_tree_stats(opts, lanes->trees[0], NULL, decoded);
+            while (next_stats <= decoded) next_stats += opts->stats_every;
+        }
+    }
+
+    return decoded;
+}
+
+// write characters of leaf node to output and update tree, the characters of the nyt node are read from io
+// returns number of characters written, 0 if the stream is corrupted
+unsigned long long emit_symbol(Tree* tree, Node* node, huffman_io* io, huffman_io* out) {
+
+    if (node != tree->nyt) {
+        if (node->strlength == 1) {
+            io_putc(out, (uint8)node->string[0]);
+        } else {
+            write_bytes(out, node->string, node->strlength);
+        }
+        int length = node->strlength;
+        update_tree(tree, node, NULL, 0);
+        return length;
+    }
+
+    // every new string is at least 1 character, the end of the stream is marked by an empty block
+    uint8 length = read_byte(io);
+    if (length == 0) return 0;
+    char str[length];
+    for (int i = 0; i < length; i++) {
+        str[i] = (char)read_byte(io);
+    }
+    write_bytes(out, str, length);
+    update_tree(tree, node, str, length);
+    return length;
+}
+
+// decode stream with order-1 contexts, returns number of characters decoded
+// each string is first decoded with the tree of the context of the previous character,
+// at its nyt node the string is decoded with the global tree and added to the context
+unsigned long long decode_contexts(Tree* tree, Contexts* contexts, huffman_io* io, huffman_io* out, huffman_options* opts) {
+
+    unsigned long long decoded = 0;
+    unsigned long long next_stats = opts->stats_every;
+    uint8 prev = 0;
+
+    while (!io->eof_reached) {
+
+        Tree* context = context_tree(contexts, prev);
+        Node* node = context->root;
+        while (node->left) {
+            node = read_bit(io) ? node->right : node->left;
+        }
+
+        if (node != context->nyt) {
+            unsigned long long length = emit_symbol(context, node, io, out);
+            prev = (uint8)node->string[length-1];
+            decoded += length;
+
+        } else {
+            // escape, decode string with the global tree
+            node = decode_prefix(tree, io);
+            while (node->left) {
+                node = read_bit(io) ? node->right : node->left;
+            }
+
+            if (node == tree->nyt) {
+                uint8 length = read_byte(io);
+                if (length == 0) break;     // end of stream
+
+                char str[length];
+                for (int i = 0; i < length; i++) {
+                    str[i] = (char)read_byte(io);
+                }
+                write_bytes(out, str, length);
+                update_tree(tree, node, str, length);
+                context_add(contexts, context, NULL, str, length);
+                prev = (uint8)str[length-1];
+                decoded += length;
+            } else {
+                unsigned long long length = emit_symbol(tree, node, io, out);
+                context_add(contexts, context, NULL, node->string, (int)length);
+                prev = (uint8)node->string[length-1];
+                decoded += length;
+            }
+        }
+
+        if (opts->stats_file && next_stats && decoded >= next_stats) {
+            export_tree_stats(opts, tree, NULL, decoded);
+            next_stats += opts->stats_every;
+        }
+    }
+
+    return decoded;
 }
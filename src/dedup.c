@@ -0,0 +1,206 @@
+#include <string.h>
+#include "dedup.h"
+#include "header.h"
+#include "huffman_util.h"
+
+// the gear hash moves up one bit per byte, so its top bits depend on the most bytes and are used for boundaries
+#define MASK_HARD (((1ULL << 15) - 1) << 49)    // 15 bits, used before DEDUP_AVG_CHUNK
+#define MASK_EASY (((1ULL << 11) - 1) << 53)    // 11 bits, used after DEDUP_AVG_CHUNK
+
+// internal functions
+void init_gear(unsigned long long* gear);
+size_t chunk_length(const char* data, size_t len, const unsigned long long* gear);
+unsigned long long chunk_hash(const char* data, size_t len);
+
+
+// read all input, split it into chunks and keep each distinct chunk once
+Dedup* dedup_input(FILE* file) {
+
+    // a regular file is mapped, anything else is read into memory
+    size_t len = 0;
+    char* buf = NULL;
+    const char* data = map_input(file, &len);
+    const char* map = data;
+    if (!map) {
+        buf = read_all(file, &len);
+        data = buf;
+    }
+
+    Dedup* dedup = dedup_memory(data, len);
+    if (map) {
+        unmap_input(map, len);
+    } else {
+        free(buf);
+    }
+    return dedup;
+}
+
+// split input that is already in memory into chunks and keep each distinct chunk once, data is not kept
+Dedup* dedup_memory(const char* data, size_t len) {
+
+    Dedup* dedup = (Dedup*)safe_calloc(1, sizeof(Dedup));
+    size_t max_chunks = len / DEDUP_MIN_CHUNK + 1;
+    dedup->refs = (unsigned int*)safe_malloc(max_chunks * sizeof(unsigned int));
+    dedup->lengths = (unsigned int*)safe_malloc(max_chunks * sizeof(unsigned int));
+    dedup->unique = (char*)safe_malloc(len + 1);
+
+    // distinct chunks, found by their hash in a table with open addressing that is at most half full
+    size_t slots = 1;
+    while (slots < 2 * max_chunks) slots <<= 1;
+    unsigned int* table = (unsigned int*)safe_calloc(slots, sizeof(unsigned int));   // number of distinct chunk plus 1, 0 if empty
+    unsigned long long* hashes = (unsigned long long*)safe_malloc(max_chunks * sizeof(unsigned long long));
+    size_t* offsets = (size_t*)safe_malloc(max_chunks * sizeof(size_t));    // position in unique
+    unsigned int* sizes = (unsigned int*)safe_malloc(max_chunks * sizeof(unsigned int));
+    unsigned int distinct = 0;
+
+    unsigned long long gear[256];
+    init_gear(gear);
+
+    size_t pos = 0;
+    while (pos < len) {
+        size_t n = chunk_length(&data[pos], len - pos, gear);
+        unsigned long long hash = chunk_hash(&data[pos], n);
+
+        size_t slot = hash & (slots - 1);
+        unsigned int ref = 0;
+        while (table[slot] && !ref) {
+            unsigned int i = table[slot] - 1;
+            if (hashes[i] == hash && sizes[i] == n && memcmp(&dedup->unique[offsets[i]], &data[pos], n) == 0) {
+                ref = i + 1;
+            } else {
+                slot = (slot + 1) & (slots - 1);
+            }
+        }
+        if (!ref) {
+            // new chunk
+            hashes[distinct] = hash;
+            offsets[distinct] = dedup->unique_len;
+            sizes[distinct] = (unsigned int)n;
+            table[slot] = ++distinct;
+            memcpy(&dedup->unique[dedup->unique_len], &data[pos], n);
+            dedup->unique_len += n;
+        }
+        dedup->refs[dedup->chunks] = ref;
+        dedup->lengths[dedup->chunks] = (unsigned int)n;
+        dedup->chunks++;
+        pos += n;
+    }
+    DEBUG_PRINT("dedup: %zu chunks, %u distinct, %zu of %zu bytes left\n", dedup->chunks, distinct, dedup->unique_len, len);
+
+    free(table);
+    free(hashes);
+    free(offsets);
+    free(sizes);
+    return dedup;
+}
+
+// random value for each byte, from splitmix64 with a fixed seed, so chunks do not depend on the run
+void init_gear(unsigned long long* gear) {
+    unsigned long long state = 0x5045525345ULL;
+    for (int i = 0; i < 256; i++) {
+        unsigned long long z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        gear[i] = z ^ (z >> 31);
+    }
+}
+
+// length of the chunk at the start of data
+// a chunk ends after the first byte where the top bits of the hash are 0, more bits must be 0 before
+// the average length than after it, this keeps lengths close to the average
+size_t chunk_length(const char* data, size_t len, const unsigned long long* gear) {
+    if (len <= DEDUP_MIN_CHUNK) return len;
+    size_t max = len < DEDUP_MAX_CHUNK ? len : DEDUP_MAX_CHUNK;
+    size_t avg = max < DEDUP_AVG_CHUNK ? max : DEDUP_AVG_CHUNK;
+
+    unsigned long long hash = 0;
+    size_t i = DEDUP_MIN_CHUNK;
+    for (; i < avg; i++) {
+        hash = (hash << 1) + gear[(uint8)data[i]];
+        if (!(hash & MASK_HARD)) return i + 1;
+    }
+    for (; i < max; i++) {
+        hash = (hash << 1) + gear[(uint8)data[i]];
+        if (!(hash & MASK_EASY)) return i + 1;
+    }
+    return max;
+}
+
+// 64 bit hash of a chunk, 8 bytes at a time
+unsigned long long chunk_hash(const char* data, size_t len) {
+    unsigned long long hash = len * 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        unsigned long long word;
+        memcpy(&word, &data[i], 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < len; i++) {
+        hash = (hash ^ (uint8)data[i]) * 0x100000001b3ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+// write the list of chunks, after the end of the stream of distinct chunks
+void write_chunks(huffman_io* io, Dedup* dedup) {
+    write_varint(io, dedup->chunks);
+    for (size_t i = 0; i < dedup->chunks; i++) {
+        write_varint(io, dedup->refs[i]);
+        if (!dedup->refs[i]) write_varint(io, dedup->lengths[i]);
+    }
+}
+
+// read the list of chunks from io and write the chunks in their order to out
+// unique holds the decoded distinct chunks, restored is set to the number of bytes written
+// returns 0 if ok, -1 if the list is corrupted or does not match the distinct chunks
+int restore_chunks(huffman_io* io, huffman_io* unique, huffman_io* out, unsigned long long* restored) {
+    *restored = 0;
+    unsigned long long chunks;
+    if (read_varint(io, &chunks)) return -1;
+
+    // position and length of each distinct chunk in unique
+    size_t size = 1 << 10;
+    size_t* offsets = (size_t*)safe_malloc(size * sizeof(size_t));
+    size_t* sizes = (size_t*)safe_malloc(size * sizeof(size_t));
+    size_t distinct = 0;
+    size_t pos = 0;
+
+    int failed = 0;
+    for (unsigned long long i = 0; i < chunks && !failed; i++) {
+        unsigned long long ref, length;
+        if (read_varint(io, &ref) || ref > distinct) {
+            failed = 1;
+        } else if (ref) {
+            write_bytes(out, (char*)&unique->buf[offsets[ref-1]], sizes[ref-1]);
+            *restored += sizes[ref-1];
+        } else if (read_varint(io, &length) || length > unique->buf_pos - pos) {
+            failed = 1;
+        } else {
+            if (distinct == size) {
+                size *= 2;
+                offsets = (size_t*)safe_realloc(offsets, size * sizeof(size_t));
+                sizes = (size_t*)safe_realloc(sizes, size * sizeof(size_t));
+            }
+            offsets[distinct] = pos;
+            sizes[distinct] = length;
+            distinct++;
+            write_bytes(out, (char*)&unique->buf[pos], length);
+            pos += length;
+            *restored += length;
+        }
+    }
+
+    free(offsets);
+    free(sizes);
+    return failed || pos != unique->buf_pos ? -1 : 0;
+}
+
+void free_dedup(Dedup* dedup) {
+    if (dedup) {
+        free(dedup->unique);
+        free(dedup->refs);
+        free(dedup->lengths);
+        free(dedup);
+    }
+}
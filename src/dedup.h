@@ -0,0 +1,35 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stdio.h>
+#include "huffman_io.h"
+
+#define DEDUP_MIN_CHUNK (1 << 11)   // chunk boundaries are only searched after this many bytes
+#define DEDUP_AVG_CHUNK (1 << 13)   // boundaries are harder to find before and easier after this many bytes
+#define DEDUP_MAX_CHUNK (1 << 16)   // chunks are cut at this size if no boundary was found
+
+// input split into content defined chunks, so a region repeated anywhere in the input is split in the same
+// chunks, except near its ends, and every distinct chunk only has to be coded once
+// boundaries are found with a gear hash of the last 64 bytes as in FastCDC, chunks are compared by
+// a 64 bit hash and then byte by byte
+// the distinct chunks are coded as one stream in the order they first occur, the list of chunks is written
+// after its end: number of chunks (varint), then for each chunk 0 and its length (varints) for a new chunk,
+// or the number of the earlier distinct chunk it repeats plus 1 (varint)
+typedef struct Dedup {
+
+    char* unique;       // distinct chunks, in the order they first occur
+    size_t unique_len;
+
+    size_t chunks;          // number of chunks in the input
+    unsigned int* refs;     // for each chunk, 0 if it is new, else number of the distinct chunk it repeats plus 1
+    unsigned int* lengths;  // for each chunk, its length
+
+} Dedup;
+
+Dedup* dedup_input(FILE* file);
+Dedup* dedup_memory(const char* data, size_t len);
+void write_chunks(huffman_io* io, Dedup* dedup);
+int restore_chunks(huffman_io* io, huffman_io* unique, huffman_io* out, unsigned long long* restored);
+void free_dedup(Dedup* dedup);
+
+#endif // DEDUP_H
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <string.h>
+#include "dict.h"
+#include "huffman_util.h"
+
+// internal functions
+unsigned int checksum(const char* data, size_t len);
+Snapshot* find_primed(Dictionary* dict, Tree* tree, int max_chars);
+
+
+// read dictionary file, returns NULL if it could not be read
+Dictionary* load_dictionary(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return NULL;
+
+    Dictionary* dict = (Dictionary*)safe_calloc(1, sizeof(Dictionary));
+    dict->data = read_all(file, &dict->len);
+    fclose(file);
+
+    dict->id = checksum(dict->data, dict->len);
+    pthread_mutex_init(&dict->lock, NULL);
+    return dict;
+}
+
+// add every line of the dictionary to the tree, lines are cut to <max_chars> characters
+// a line that is already in the tree increases the weight of its leaf
+// tree must be new, apart from its run leaf, the first tree primed in each way is saved as a snapshot,
+// and the trees primed in the same way after it are copied from the snapshot
+void prime_tree(Tree* tree, Dictionary* dict, int max_chars) {
+    pthread_mutex_lock(&dict->lock);
+    Snapshot* snapshot = find_primed(dict, tree, max_chars);
+    pthread_mutex_unlock(&dict->lock);
+    if (snapshot) {
+        restore_snapshot(tree, snapshot);
+        return;
+    }
+
+    int run_leaf = tree->run_leaf != NULL;
+    size_t start = 0;
+    while (start < dict->len) {
+        const char* line = &dict->data[start];
+        const char* end = memchr(line, '\n', dict->len - start);
+        size_t len = end ? (size_t)(end - line) : dict->len - start;
+        start += len + 1;
+
+        if (len == 0) continue;
+        if (len > (size_t)max_chars) len = max_chars;
+
+        Node* node = tree_find_node(tree, line, (int)len);
+        update_tree(tree, node ? node : tree->nyt, line, (int)len);
+    }
+
+    // another thread may have saved the same way of priming meanwhile
+    pthread_mutex_lock(&dict->lock);
+    if (dict->num_primed < DICT_SNAPSHOTS && !find_primed(dict, tree, max_chars)) {
+        Primed_tree* primed = &dict->primed[dict->num_primed++];
+        primed->max_chars = max_chars;
+        primed->max_weight = tree->max_weight;
+        primed->run_leaf = run_leaf;
+        primed->snapshot = take_snapshot(tree);
+    }
+    pthread_mutex_unlock(&dict->lock);
+}
+
+// snapshot of a tree primed in the same way as tree would be, NULL if none was saved, the lock must be held
+Snapshot* find_primed(Dictionary* dict, Tree* tree, int max_chars) {
+    for (int i = 0; i < dict->num_primed; i++) {
+        Primed_tree* primed = &dict->primed[i];
+        if (primed->max_chars == max_chars && primed->max_weight == tree->max_weight && primed->run_leaf == (tree->run_leaf != NULL)) {
+            return primed->snapshot;
+        }
+    }
+    return NULL;
+}
+
+void free_dictionary(Dictionary* dict) {
+    if (dict) {
+        for (int i = 0; i < dict->num_primed; i++) {
+            free_snapshot(dict->primed[i].snapshot);
+        }
+        pthread_mutex_destroy(&dict->lock);
+        free(dict->data);
+        free(dict);
+    }
+}
+
+// 32 bit FNV-1a hash
+unsigned int checksum(const char* data, size_t len) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,37 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "huffman.h"
+#include "snapshot.h"
+
+#define DICT_SNAPSHOTS 8    // primed trees saved per dictionary, one for each way of priming used
+
+// tree primed with a dictionary, saved so other trees primed the same way are copied from it
+typedef struct Primed_tree {
+    int max_chars;          // lines are cut to this length
+    unsigned int max_weight;    // bound on the depth of the tree, see set_max_depth
+    int run_leaf;           // tree had a run leaf before it was primed
+    Snapshot* snapshot;
+} Primed_tree;
+
+// dictionary of strings that are added to a new tree before coding, so short inputs start with a useful tree
+// the dictionary file has one string per line, a string occurring on several lines gets a higher weight
+// encoder and decoder prime their trees in the same way, the stream stores only the id of the dictionary
+typedef struct Dictionary {
+    char* data;     // contents of the file
+    size_t len;
+    unsigned int id;    // checksum of the contents
+
+    // the trees of batch files and daemon requests are primed on several threads
+    pthread_mutex_t lock;
+    Primed_tree primed[DICT_SNAPSHOTS];
+    int num_primed;
+} Dictionary;
+
+Dictionary* load_dictionary(const char* filename);
+void prime_tree(Tree* tree, Dictionary* dict, int max_chars);
+void free_dictionary(Dictionary* dict);
+
+#endif // DICT_H
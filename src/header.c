@@ -0,0 +1,116 @@
+#include "header.h"
+#include "huffman.h"
+#include "lanes.h"
+#include "lz77.h"
+
+// write header, must be called before anything else is written
+void write_header(huffman_io* io, Header* header) {
+    io_putc(io, HEADER_MAGIC_0);
+    io_putc(io, HEADER_MAGIC_1);
+    io_putc(io, HEADER_VERSION);
+    io_putc(io, (uint8)header->max_chars);
+    io_putc(io, (uint8)(header->max_mem | header->engine << 4));
+    io_putc(io, (uint8)header->flags);
+
+    if (header->flags & HEADER_HAS_SIZE) {
+        write_varint(io, header->original_size);
+    }
+    if (header->flags & HEADER_HAS_LANES) {
+        io_putc(io, (uint8)header->lanes);
+    }
+    if (header->flags & HEADER_HAS_CONTEXTS) {
+        io_putc(io, (uint8)(header->contexts - 1));
+    }
+    if (header->flags & HEADER_HAS_DICT) {
+        write_varint(io, header->dict_id);
+    }
+    if (header->flags & HEADER_HAS_MAX_DEPTH) {
+        io_putc(io, (uint8)header->max_depth);
+    }
+    if (header->flags & HEADER_HAS_WINDOW) {
+        io_putc(io, (uint8)header->window);
+    }
+}
+
+// read header, must be called before anything else is read
+// returns 0 if a valid header was read, -1 if input is not a stream written by this version
+int read_header(huffman_io* io, Header* header) {
+    if (io_getc(io) != HEADER_MAGIC_0 || io_getc(io) != HEADER_MAGIC_1) return -1;
+    if (io_getc(io) != HEADER_VERSION) return -1;
+
+    int max_chars = io_getc(io);
+    int mem_engine = io_getc(io);
+    int flags = io_getc(io);
+    if (max_chars == EOF || mem_engine == EOF || flags == EOF) return -1;
+
+    header->max_chars = max_chars;
+    header->max_mem = mem_engine & 0xf;
+    header->engine = (engine)(mem_engine >> 4);
+    header->flags = flags;
+    if (header->max_chars < 1 || header->max_mem > 9 || header->engine > ENGINE_LZ77 || (flags & ~HEADER_FLAGS)) return -1;
+
+    header->original_size = 0;
+    if ((flags & HEADER_HAS_SIZE) && read_varint(io, &header->original_size)) return -1;
+
+    header->lanes = 1;
+    if (flags & HEADER_HAS_LANES) {
+        header->lanes = io_getc(io);
+        if (header->lanes < 1 || header->lanes > LANES_MAX) return -1;
+    }
+
+    header->contexts = 0;
+    if (flags & HEADER_HAS_CONTEXTS) {
+        int c = io_getc(io);
+        if (c == EOF || (c & (c + 1))) return -1;  // must be a power of 2 minus 1
+        header->contexts = c + 1;
+    }
+
+    header->dict_id = 0;
+    if (flags & HEADER_HAS_DICT) {
+        unsigned long long id;
+        if (read_varint(io, &id) || id > 0xffffffffULL) return -1;
+        header->dict_id = (unsigned int)id;
+    }
+
+    header->max_depth = 0;
+    if (flags & HEADER_HAS_MAX_DEPTH) {
+        header->max_depth = io_getc(io);
+        if (header->max_depth < MIN_MAX_DEPTH || header->max_depth > MAX_MAX_DEPTH) return -1;
+    }
+
+    // the LZ77 engine codes with one tree for literals and one for distances, without lanes, contexts or dictionary
+    header->window = 0;
+    if ((header->engine == ENGINE_LZ77) != !!(flags & HEADER_HAS_WINDOW)) return -1;
+    if (flags & HEADER_HAS_WINDOW) {
+        header->window = io_getc(io);
+        if (header->window < LZ77_MIN_WINDOW || header->window > LZ77_MAX_WINDOW) return -1;
+        if (flags & (HEADER_HAS_LANES | HEADER_HAS_CONTEXTS | HEADER_HAS_DICT)) return -1;
+    }
+
+    // runs are only coded with one tree
+    if ((flags & HEADER_HAS_RUNS) && (flags & (HEADER_HAS_LANES | HEADER_HAS_CONTEXTS | HEADER_HAS_WINDOW))) return -1;
+
+    return 0;
+}
+
+// write value in 7 bits per byte, least significant first, the high bit is set in all but the last byte
+void write_varint(huffman_io* io, unsigned long long value) {
+    while (value >= 0x80) {
+        io_putc(io, (uint8)(value | 0x80));
+        value >>= 7;
+    }
+    io_putc(io, (uint8)value);
+}
+
+// read value written by write_varint
+// returns 0 if ok, -1 on end of input or overflow
+int read_varint(huffman_io* io, unsigned long long* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = io_getc(io);
+        if (c == EOF) return -1;
+        *value |= (unsigned long long)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
@@ -0,0 +1,54 @@
+#ifndef HEADER_H
+#define HEADER_H
+
+#include "huffman_io.h"
+
+#define HEADER_MAGIC_0 'P'
+#define HEADER_MAGIC_1 'S'
+#define HEADER_VERSION 1
+
+// engine used to encode the stream
+typedef enum engine {
+    ENGINE_STRINGS = 0, // leaf nodes with strings of up to max_chars characters
+    ENGINE_BYTES = 1,   // leaf nodes with single characters only (max_chars = 1)
+    ENGINE_LZ77 = 2     // literals and matches with earlier input, see lz77.h
+} engine;
+
+// header flags, optional fields are stored after the fixed part in the order of these flags
+#define HEADER_HAS_SIZE 0x01    // original size of the input is stored
+#define HEADER_HAS_LANES 0x02   // number of interleaved lanes is stored, 1 if not set
+#define HEADER_HAS_CONTEXTS 0x04    // number of order-1 context classes is stored, no contexts if not set
+#define HEADER_HAS_DICT 0x08    // trees were primed with a dictionary, its id is stored
+#define HEADER_HAS_MAX_DEPTH 0x10   // depth of the trees is bounded, the bound is stored
+#define HEADER_HAS_DEDUP 0x20   // only distinct chunks of the input are coded, the list of chunks follows the stream, see dedup.h
+#define HEADER_HAS_WINDOW 0x40  // log2 of the window of the LZ77 engine is stored, set if and only if the engine is LZ77
+#define HEADER_HAS_RUNS 0x80    // the trees start with a run leaf, see rle.h
+#define HEADER_FLAGS 0xff       // all known flags, a stream with other flags needs a newer decoder
+
+// header at the start of a compressed stream
+// layout: magic (2 bytes), version, max_chars, max_mem | engine << 4, flags, optional fields
+// the original size is stored as a varint (7 bits per byte, least significant first), lanes as one byte,
+// context classes minus 1 as one byte, dictionary id as a varint, max depth as one byte, window as one byte
+typedef struct Header {
+
+    int max_chars;  // LEN used by the encoder
+    int max_mem;    // MEM used by the encoder
+    engine engine;
+    int flags;
+
+    unsigned long long original_size;   // only valid if flags & HEADER_HAS_SIZE
+    int lanes;      // number of models symbols are assigned to round robin, see lanes.h
+    int contexts;   // number of order-1 context classes, 0 for none, see context.h
+    unsigned int dict_id;   // id of the dictionary, only valid if flags & HEADER_HAS_DICT, see dict.h
+    int max_depth;  // bound on the depth of the trees, 0 for none
+    int window;     // log2 of the window of the LZ77 engine, only valid if flags & HEADER_HAS_WINDOW
+
+} Header;
+
+void write_header(huffman_io* io, Header* header);
+int read_header(huffman_io* io, Header* header);
+
+void write_varint(huffman_io* io, unsigned long long value);
+int read_varint(huffman_io* io, unsigned long long* value);
+
+#endif // HEADER_H
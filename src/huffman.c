@@ -1,21 +1,54 @@
 #include "huffman.h"
 #include "huffman_util.h"
 #include "trie.h"
+#include "arena.h"
+#include "decode_table.h"
 #include <string.h>
 
 // internal functions
-Node* add_new(Tree* tree, char* str, int length);
+Node* add_new(Tree* tree, const char* str, int length);
 void swap_nodes(Node* node1, Node* node2);
 void swap_list(Node* A, Node* B);
 void refresh_outer_pointers(Node* A);
-
+void clear_codes(Node* node);
+
+
+// default options: single characters per node, smallest memory limit, no io threads
+huffman_options init_options() {
+    huffman_options opts;
+    opts.max_chars = 1;
+    opts.max_mem = 0;
+    opts.objective = 0;
+    opts.level = 9;
+    opts.lazy = 0;
+    opts.cost = 0;
+    opts.analysis = 0;
+    opts.pipelined = 0;
+    opts.lanes = 1;
+    opts.contexts = 0;
+    opts.dict = NULL;
+    opts.max_depth = 0;
+    opts.dedup = 0;
+    opts.window = 0;
+    opts.rle = 0;
+    opts.adaptive = 0;
+    opts.mem_limit = -1;
+    opts.checkpoint = NULL;
+    opts.append = 0;
+    opts.stats_file = NULL;
+    opts.stats_csv = 0;
+    opts.stats_every = 0;
+    return opts;
+}
 
 // initialize huffman tree with root node, root node is always nyt node at start
 Tree* init_tree() {
-    Tree* tree = (Tree*)safe_malloc(sizeof(Tree));
+    Tree* tree = (Tree*)safe_calloc(1, sizeof(Tree));  // calloc sets byte_leaf to NULL
+
+    tree->arena = init_arena();
 
     // initialize root(=nyt) node
-    tree->root = (Node*)safe_calloc(1, sizeof(Node));  // calloc sets everything to 0
+    tree->root = (Node*)arena_alloc(tree->arena, sizeof(Node));  // arena memory is set to 0
     tree->nyt = tree->root;
 
     // initialize trie
@@ -26,12 +59,43 @@ Tree* init_tree() {
     return tree;
 }
 
+// initialize tree of an order-1 context, see context.h
+// its nodes are allocated from a shared arena, and it has no trie, so its strings cannot be looked up
+Tree* init_context_tree(Arena* arena) {
+    Tree* tree = (Tree*)safe_calloc(1, sizeof(Tree));
+    tree->arena = arena;
+    tree->root = (Node*)arena_alloc(tree->arena, sizeof(Node));
+    tree->nyt = tree->root;
+    tree->nodes = 1;
+    return tree;
+}
+
+// remove all nodes from tree, but keep the allocated memory for reuse
+void reset_tree(Tree* tree) {
+    reset_arena(tree->arena);
+    clear_trie(tree->trie);
+    memset(tree->byte_leaf, 0, sizeof(tree->byte_leaf));
+    tree->run_leaf = NULL;
+
+    tree->root = (Node*)arena_alloc(tree->arena, sizeof(Node));
+    tree->nyt = tree->root;
+    tree->nodes = 1;
+    decode_table_touch(tree, tree->root);
+}
+
 // update huffman tree with a given string
-void update_tree(Tree* tree, Node* node, char* str, int length) {
+void update_tree(Tree* tree, Node* node, const char* str, int length) {
+
+    // with a bounded depth, rescale before the root would reach max weight
+    // this is done first, so a new leaf is still the sibling of nyt after the update
+    if (tree->max_weight && tree->root->weight + 1 >= tree->max_weight) {
+        rescale_tree(tree);
+    }
     
     // check if tree contains character
     if (node == tree->nyt || !node) {
         // character not in tree, add character to tree
+        decode_table_touch(tree, tree->nyt);
         node = add_new(tree, str, length);
         // if node is null, update is done
         if (!node) return;
@@ -48,6 +112,8 @@ void update_tree(Tree* tree, Node* node, char* str, int length) {
 
         if (min_node != node && min_node != node->parent) {
             // swap min_node and node
+            decode_table_touch(tree, min_node);
+            decode_table_touch(tree, node);
             swap_nodes(min_node, node);
         }
         
@@ -60,17 +126,108 @@ void update_tree(Tree* tree, Node* node, char* str, int length) {
     node->weight++;
 }
 
+// bound the depth of the tree to max_depth, 0 for no bound
+// a node at depth d has a root weight of at least fib(d+2), the weights are halved before a code can get longer
+void set_max_depth(Tree* tree, int max_depth) {
+    tree->max_weight = depth_weight(max_depth);
+}
+
+// smallest root weight of a tree with a code longer than max_depth, i.e. fib(max_depth+3)
+// nyt has weight 0, but its sibling is at the same depth, so it counts too
+// returns 0 for max_depth 0
+unsigned int depth_weight(int max_depth) {
+    if (!max_depth) return 0;
+    unsigned int fib = 1, next = 1;     // fib(1), fib(2)
+    for (int i = 1; i < max_depth + 3; i++) {
+        unsigned int tmp = fib + next;
+        fib = next;
+        next = tmp;
+    }
+    return fib;
+}
+
+// maximum number of nodes of a tree with a bounded depth, at most max_nodes
+// at most a quarter of the root weight at which the tree is rescaled is in leaves,
+// so halving the weights makes room for many updates
+int bounded_tree_nodes(int max_nodes, int max_depth) {
+    int bound = (int)(depth_weight(max_depth) / 2);
+    return max_depth && max_nodes > bound ? bound : max_nodes;
+}
+
+// halve the weights of all leaves and rebuild the tree from them
+// leaves keep their node, so lookups in the trie and lookup table stay valid
+// nodes are merged as in the static huffman algorithm, lightest first, and get their order in the order
+// they are merged, so the order list has non-increasing weights and siblings are next to each other
+void rescale_tree(Tree* tree) {
+
+    int n = tree->nodes;
+    int leaves = (n + 1) / 2;   // nyt included
+    Node** leaf = (Node**)safe_malloc(leaves * sizeof(Node*));
+    Node** merged = (Node**)safe_malloc(leaves * sizeof(Node*));   // internal nodes, reused in the order they are merged
+    Node** taken = (Node**)safe_malloc(n * sizeof(Node*));         // nodes in the order they are merged
+
+    // from the end of the order list, so leaves are sorted by increasing weight, with nyt first
+    // (w+1)/2 keeps this order, and every leaf but nyt a weight of at least 1
+    int num_leaves = 0, num_internal = 0;
+    for (Node* node = tree->nyt; node; node = node->prev_ord) {
+        node->code = 0;     // all codes change
+        if (node->left) {
+            merged[num_internal++] = node;
+        } else {
+            node->weight = (node->weight + 1) / 2;
+            leaf[num_leaves++] = node;
+        }
+    }
+
+    // merge the 2 lightest nodes until one is left, leaves go first on equal weights
+    int next_leaf = 0, next_merged = 0, made = 0, num_taken = 0;
+    while (num_taken < n - 1) {
+        Node* pair[2];
+        for (int k = 0; k < 2; k++) {
+            if (next_leaf < num_leaves && (next_merged == made || leaf[next_leaf]->weight <= merged[next_merged]->weight)) {
+                pair[k] = leaf[next_leaf++];
+            } else {
+                pair[k] = merged[next_merged++];
+            }
+            taken[num_taken++] = pair[k];
+        }
+        // the lighter node is the left child, as nyt is in add_new
+        Node* parent = merged[made++];
+        parent->left = pair[0];
+        parent->right = pair[1];
+        parent->weight = pair[0]->weight + pair[1]->weight;
+        pair[0]->parent = parent;
+        pair[1]->parent = parent;
+    }
+    tree->root = n > 1 ? merged[made-1] : tree->nyt;
+    tree->root->parent = NULL;
+    taken[num_taken++] = tree->root;
+
+    // the first node merged is last in the order list
+    for (int i = 0; i < n; i++) {
+        Node* node = taken[i];
+        node->order = n - 1 - i;
+        node->next_ord = i > 0 ? taken[i-1] : NULL;
+        node->prev_ord = i < n-1 ? taken[i+1] : NULL;
+    }
+
+    free(leaf);
+    free(merged);
+    free(taken);
+    decode_table_touch(tree, tree->root);
+}
+
 // add a new character to a huffman tree
 // this is done by replacing the nyt node with a small tree of 3 nodes: an internal node with 2 children, the nyt node and the new character node
 // returns the parent of the new internal node, this will be null if this node has no parent
-Node* add_new(Tree* tree, char* str, int length) {
+Node* add_new(Tree* tree, const char* str, int length) {
 
     // get nyt node
     Node* nyt_node = tree->nyt;
 
     // create and initialize new internal node and new leaf node
-    Node* internal_node = (Node*)safe_calloc(1, sizeof(Node));
-    Node* leaf_node = (Node*)safe_calloc(1, sizeof(Node));
+    Node* internal_node = (Node*)arena_alloc(tree->arena, sizeof(Node));
+    Node* leaf_node = (Node*)arena_alloc(tree->arena, sizeof(Node));
     
     internal_node->weight = 1;
     internal_node->order = nyt_node->order;
@@ -78,7 +235,7 @@ Node* add_new(Tree* tree, char* str, int length) {
     internal_node->left = nyt_node;
     internal_node->right = leaf_node;
 
-    leaf_node->string = safe_malloc(sizeof(char)*(length+1));    // length +1 for null termination
+    leaf_node->string = arena_alloc(tree->arena, sizeof(char)*(length+1));    // length +1 for null termination
     memcpy(leaf_node->string, str, length);
     leaf_node->string[length] = '\0';
     leaf_node->strlength = length;
@@ -101,6 +258,7 @@ Node* add_new(Tree* tree, char* str, int length) {
 
     nyt_node->order = nyt_node->order + 2;
     nyt_node->parent = internal_node;
+    nyt_node->code = 0;     // code of nyt is one bit longer now
 
     // update order list
     internal_node->prev_ord = nyt_node->prev_ord;
@@ -115,8 +273,12 @@ Node* add_new(Tree* tree, char* str, int length) {
     nyt_node->prev_ord = leaf_node;
     // nyt_node->next_ord is always null
 
-    // add new leaf node to trie
-    trie_add_string_node(tree->trie, str, length, leaf_node);
+    // add new leaf node to lookup table or trie, the empty string of a run leaf is in neither
+    if (length == 1) {
+        tree->byte_leaf[(unsigned char)str[0]] = leaf_node;
+    } else if (tree->trie && length > 1) {
+        trie_add_string_node(tree->trie, str, length, leaf_node);
+    }
 
     // increment node counter
     tree->nodes += 2;
@@ -127,6 +289,10 @@ Node* add_new(Tree* tree, char* str, int length) {
 // swap 2 nodes in tree but keep order numbers
 void swap_nodes(Node* A, Node* B) {
 
+    // codes of all leaves below A and B change
+    clear_codes(A);
+    clear_codes(B);
+
     // swap child pointers of parents
     if (A->parent->left == A) {     // A is left child
         A->parent->left = B;
@@ -189,6 +355,36 @@ void swap_list(Node* A, Node* B) {
     refresh_outer_pointers(B);
 }
 
+// cache the code of a leaf in leaf->code, with a 1 in front of it, if it is at most MAX_CACHED_CODE bits long
+// its ancestors are marked, so clear_codes only has to visit marked nodes
+void cache_code(Node* leaf) {
+
+    // the bit of the edge above node is put at its distance to the leaf, so the root edge ends up in front
+    unsigned int code = 0;
+    int length = 0;
+    for (Node* node = leaf; node->parent; node = node->parent) {
+        if (length == MAX_CACHED_CODE) return;
+        code |= (unsigned int)(node->parent->right == node) << length++;
+    }
+    leaf->code = code | 1u << length;
+
+    // once a marked ancestor is reached, all nodes above it are marked too
+    for (Node* node = leaf->parent; node && !node->code; node = node->parent) {
+        node->code = 1;
+    }
+}
+
+// remove cached codes of all leaves below node, including node
+// unmarked nodes have no cached codes below them, so the time spent is bounded by the time spent caching
+void clear_codes(Node* node) {
+    if (!node->code) return;
+    node->code = 0;
+    if (node->left) {
+        clear_codes(node->left);
+        clear_codes(node->right);
+    }
+}
+
 // helper function for swapping nodes in order list
 void refresh_outer_pointers(Node* node) {
     if (node->prev_ord){
@@ -201,11 +397,44 @@ void refresh_outer_pointers(Node* node) {
 
 
 // find leaf node in tree with given string
-Node* tree_find_node(Tree* tree, char* str, int length) {
+Node* tree_find_node(Tree* tree, const char* str, int length) {
+    if (length == 1) {
+        return tree->byte_leaf[(unsigned char)str[0]];
+    }
     Trie_node* t_node = trie_find_string(tree->trie, str, length);
     return t_node ? t_node->data.huff_node : NULL;
 }
 
+// find the leaf node with the longest string that is a prefix of str
+// returns the length of its string and sets node, returns 0 and sets node to NULL if no prefix is in the tree
+int tree_longest_prefix(Tree* tree, const char* str, int length, Node** node) {
+    *node = NULL;
+    if (length <= 0) return 0;
+    int longest = length > 1 ? trie_longest_prefix(tree->trie, str, length, node) : 0;
+    if (!longest && (*node = tree->byte_leaf[(unsigned char)str[0]])) {
+        longest = 1;
+    }
+    return longest;
+}
+
+// find the leaf nodes of all prefixes of str
+// leaves[len] is set to the leaf node with the prefix of length len, NULL if not in tree
+void tree_prefix_leaves(Tree* tree, const char* str, int length, Node** leaves) {
+    if (length <= 0) return;
+    trie_prefix_nodes(tree->trie, str, length, leaves);
+    leaves[1] = tree->byte_leaf[(unsigned char)str[0]];
+}
+
+// number of edges between node and root, this is the length of its code
+int node_depth(Node* node) {
+    int depth = 0;
+    while (node->parent) {
+        node = node->parent;
+        depth++;
+    }
+    return depth;
+}
+
 // get the size of the tree in bytes
 unsigned long tree_size(Tree* tree) {
     return tree->nodes * sizeof(Node) + sizeof(Tree);
@@ -254,21 +483,20 @@ void print_tree(Tree* tree) {
     printf("--------------------\n\n");
 }
 
-// recursively free memory allocated by nodes
-void free_tree_node_rec(Node* node) {
-    if (node) {
-        free_tree_node_rec(node->left);
-        free_tree_node_rec(node->right);
-        free(node->string);
-        free(node);
-    }
-}
-
 // free memory allocated by huffman tree
+// context trees have no trie, their arena is freed with the contexts
 void free_tree(Tree* tree) {
     if (tree) {
-        free_tree_node_rec(tree->root);
-        free_trie(tree->trie);
+        if (tree->trie) {
+            free_arena(tree->arena);
+            free_trie(tree->trie);
+        }
+        free(tree->decode);
         free(tree);
     }
+}
+
+// returns the leaf node added last, this is the sibling of the nyt node
+Node* tree_last_added(Tree* tree) {
+    return tree->nyt->parent ? tree->nyt->parent->right : NULL;
 }
\ No newline at end of file
@@ -1,15 +1,27 @@
 #ifndef HUFFMAN_H
 #define HUFFMAN_H
 
+#define MIN_MAX_DEPTH 16    // bounds for the length of codes with a bounded depth
+#define MAX_MAX_DEPTH 44    // weights of a tree this deep still fit in an unsigned int
+
 #include <stdio.h>
 
 typedef struct Trie Trie;   // forward declaration
+typedef struct Arena Arena; // forward declaration
+typedef struct Lookahead Lookahead;     // forward declaration
+typedef struct huffman_io huffman_io;   // forward declaration
+typedef struct Dictionary Dictionary;   // forward declaration
+typedef struct Checkpoint Checkpoint;   // forward declaration
+typedef struct Decode_table Decode_table;   // forward declaration
 
 // path type contains a path from a node to the root (or vice versa)
-// type depends on max depth of tree, i.e. int -> max depth = 31 (= 32 - 1)
+// type depends on the number of bits written at once, i.e. int -> 31 (= 32 - 1) bits
+// longer paths are written in parts, see write_code
 typedef unsigned long path;
 static const path MAX_PATH = ~ ((path)~0 >> 1);    // 0b100...00
 
+#define MAX_CACHED_CODE 31  // longest code cached in a leaf, the 1 in front must fit in an unsigned int
+
 
 typedef struct Node {   // Huffman tree node
 
@@ -21,6 +33,10 @@ typedef struct Node {   // Huffman tree node
     unsigned int weight;
     unsigned int order;
 
+    // leaf: its code with a 1 in front, 0 if not cached, see write_code
+    // internal node: not 0 if a leaf below it may have a cached code
+    unsigned int code;
+
     struct Node* parent; // parent node
 
     // a node must always have 0 or 2 children
@@ -36,27 +52,95 @@ typedef struct Tree {   // Huffman tree
     Node* root; // root node
     Node* nyt; // nyt node
 
-    // ternary trie with all strings added to the tree
+    // ternary trie with all strings of 2 or more characters added to the tree
     // for finding the leaf node with a given string
     Trie* trie;
 
+    // leaf node of each single character, NULL if not in tree
+    // single characters are looked up directly instead of in the trie
+    Node* byte_leaf[256];
+
+    // memory for nodes and leaf strings
+    Arena* arena;
+
     int nodes; // number of nodes in the tree
-} Tree;     // 32 bytes total
+
+    // weights are halved when the root reaches this weight, this bounds the depth of the tree, 0 for no bound
+    unsigned int max_weight;
+
+    // lookup table for the top levels of the tree, only used by the decoder, NULL if none, see decode_table.h
+    Decode_table* decode;
+
+    // leaf with an empty string that codes a run of one character, NULL if runs are not coded, see rle.h
+    Node* run_leaf;
+} Tree;     // 2104 bytes total
+
+
+// settings for compression and decompression, see init_options() for defaults
+typedef struct huffman_options {
+
+    int max_chars;  // upper bound for number of characters in one leaf node, 0 to choose LEN and MEM from a sample
+    int objective;  // what LEN and MEM are chosen for if max_chars is 0, see tune.h
+    int max_mem;    // index in memory lookup table
+    int level;      // compression level, 1 (fastest) to 9 (best compression)
+    int lazy;       // number of later positions checked for a longer string before encoding, 0 to 2
+    int cost;       // choose strings by estimated number of bits per character instead of by count
+    int analysis;   // count strings on a separate thread that runs ahead of the coder
+    int pipelined;  // read input and write output on separate threads
+    int lanes;      // number of trees symbols are assigned to round robin, see lanes.h
+    int contexts;   // number of order-1 context classes, 0 for no contexts, see context.h
+    Dictionary* dict;   // strings added to the trees before coding, NULL for none, see dict.h
+    int max_depth;  // bound on the length of codes, 0 for no bound, see set_max_depth
+    int dedup;      // compress: code every distinct chunk of the input once, see dedup.h
+    int window;     // compress: log2 of the window of the LZ77 engine, 0 for the string engine, see lz77.h
+    int rle;        // compress: code runs of one character with the run leaf, see rle.h
+    int adaptive;   // compress: adapt the number of characters probed at each position to the input, see probe.h
+    int mem_limit;  // decompress: refuse streams encoded with a higher MEM index, -1 for no limit
+    const char* checkpoint; // compress: save encoder state to this file at the end, decompress: start at this saved state, see checkpoint.h
+    int append;     // compress: continue the stream in the output file from the state saved in checkpoint
+
+    FILE* stats_file;   // write tree statistics to this file, NULL for no statistics
+    int stats_csv;      // write statistics as csv rows instead of json lines
+    unsigned long long stats_every; // also write statistics every <stats_every> bytes of input, 0 for only at the end
+
+} huffman_options;
+
+huffman_options init_options();
+
+// maximum memory usage in bytes for each MEM index
+extern const int MEM_LIMIT[];
+int calc_max_tree_nodes(int max_mem, int max_chars);
 
 
 // huffman tree functions
 
 Tree* init_tree();
-void update_tree(Tree* tree, Node* node, char* str, int length);
-Node* tree_find_node(Tree* tree, char* str, int length);
+Tree* init_context_tree(Arena* arena);
+void reset_tree(Tree* tree);
+void update_tree(Tree* tree, Node* node, const char* str, int length);
+void set_max_depth(Tree* tree, int max_depth);
+unsigned int depth_weight(int max_depth);
+int bounded_tree_nodes(int max_nodes, int max_depth);
+void rescale_tree(Tree* tree);
+Node* tree_find_node(Tree* tree, const char* str, int length);
+int tree_longest_prefix(Tree* tree, const char* str, int length, Node** node);
+void tree_prefix_leaves(Tree* tree, const char* str, int length, Node** leaves);
+Node* tree_last_added(Tree* tree);
+int node_depth(Node* node);
+int write_code(huffman_io* io, Node* node);
+void cache_code(Node* leaf);
 unsigned long tree_size(Tree* tree);
 void print_tree(Tree* tree);
 void free_tree(Tree* tree);
 //
 
 
-void compress(int max_chars, int max_mem, FILE* inputfile, FILE* outputfile);
+void compress(huffman_options* opts, FILE* inputfile, FILE* outputfile);
+void compress_tree(Tree* tree, Trie* trie, huffman_options* opts, FILE* inputfile, FILE* outputfile);
+void compress_memory(Tree* tree, Trie* trie, huffman_options* opts, const char* data, size_t len, FILE* outputfile);
+void encode_input(Tree* first_tree, Trie* trie, huffman_options* opts, Lookahead* la, huffman_io* out, Checkpoint* state);
 
-void decompress(FILE* inputfile, FILE* outputfile);
+void decompress(huffman_options* opts, FILE* inputfile, FILE* outputfile);
+int decompress_tree(Tree* tree, huffman_options* opts, FILE* inputfile, FILE* outputfile);
 
 #endif //HUFFMAN_H
\ No newline at end of file
@@ -1,7 +1,16 @@
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "huffman_io.h"
+#include "huffman_util.h"
+
+// internal functions
+void fill_buffer(huffman_io* io);
+void empty_buffer(huffman_io* io);
 
 // create huffman io struct
-// mode is READ or WRITE
+// mode is READ or WRITE, in WRITE mode file may be NULL to only count the output
 huffman_io init_io(FILE* file, io_mode mode) {
     huffman_io io;
     io.file = file;
@@ -10,9 +19,112 @@ huffman_io init_io(FILE* file, io_mode mode) {
     // if mode is read, initialize bits_set with 8 to read first byte
     io.bits_set = mode == READ ? 8 : 0;
 
+    io.buf = (uint8*)safe_malloc(IO_BUF_SIZE);
+    io.buf_size = IO_BUF_SIZE;
+    io.buf_len = 0;
+    io.buf_pos = 0;
+    io.memory = 0;
+    io.bytes_out = 0;
+    io.pipe = NULL;
+
+    return io;
+}
+
+// create huffman io struct that reads or writes the file on a separate thread
+huffman_io init_pipelined_io(FILE* file, io_mode mode) {
+    huffman_io io = init_io(file, mode);
+    io.pipe = mode == READ ? start_reader(file) : start_writer(file);
     return io;
 }
 
+// create huffman io struct without a file, written bytes are kept in the buffer, which grows as needed
+// it can be read back with load_memory_io
+huffman_io init_memory_io() {
+    huffman_io io = init_io(NULL, WRITE);
+    io.memory = 1;
+    return io;
+}
+
+// discard all bytes of a memory io and start writing at the beginning of the buffer
+void reset_memory_io(huffman_io* io) {
+    io->buf_pos = 0;
+    io->buf_len = 0;
+    io->curr_byte = 0;
+    io->bits_set = 0;
+    io->eof_reached = 0;
+}
+
+// replace contents of a memory io by the next n bytes of src, and start reading them
+void load_memory_io(huffman_io* io, huffman_io* src, size_t n) {
+    if (n > io->buf_size) {
+        io->buf_size = n;
+        io->buf = (uint8*)safe_realloc(io->buf, n);
+    }
+    reset_memory_io(io);
+    io->buf_len = read_bytes(src, (char*)io->buf, n);
+    io->bits_set = 8;   // read first byte on the first bit
+}
+
+// write all buffered bytes, stop the io thread and free the buffer
+// call flush first to write the last incomplete byte
+void close_io(huffman_io* io) {
+    if (!io->memory) empty_buffer(io);
+    stop_pipeline(io->pipe);
+    io->pipe = NULL;
+    free(io->buf);
+    io->buf = NULL;
+}
+
+// refill the read buffer from the file or the reader thread
+void fill_buffer(huffman_io* io) {
+    if (io->memory) {
+        io->buf_len = 0;    // all input is in the buffer
+        return;
+    } else if (io->pipe) {
+        io->buf_len = pipeline_read(io->pipe, (char*)io->buf, IO_BUF_SIZE);
+    } else {
+        io->buf_len = fread(io->buf, sizeof(uint8), IO_BUF_SIZE, io->file);
+    }
+    io->buf_pos = 0;
+}
+
+// write the contents of the write buffer to the file or the writer thread
+void empty_buffer(huffman_io* io) {
+    if (io->memory) {
+        // keep bytes, make room for more
+        io->buf_size *= 2;
+        io->buf = (uint8*)safe_realloc(io->buf, io->buf_size);
+        return;
+    }
+    if (io->buf_pos == 0) return;
+    io->bytes_out += io->buf_pos;
+    if (!io->file) {
+        // dry run, nothing is written
+    } else if (io->pipe) {
+        pipeline_write(io->pipe, (char*)io->buf, io->buf_pos);
+    } else {
+        fwrite(io->buf, sizeof(uint8), io->buf_pos, io->file);
+    }
+    io->buf_pos = 0;
+}
+
+// get next byte from read buffer, returns EOF at end of input
+int io_getc(huffman_io* io) {
+    if (io->buf_pos == io->buf_len) {
+        fill_buffer(io);
+        if (io->buf_len == 0) return EOF;
+    }
+    return io->buf[io->buf_pos++];
+}
+
+// put byte in write buffer
+void io_putc(huffman_io* io, uint8 byte) {
+    if (io->buf_pos == io->buf_size) {
+        empty_buffer(io);
+    }
+    io->buf[io->buf_pos++] = byte;
+}
+
 // read one bit from input
 // if input could not be read, or end of input is reached, set eof_reached flag
 uint8 read_bit(huffman_io* io) {
@@ -20,7 +132,7 @@ uint8 read_bit(huffman_io* io) {
     // 8 bits read, read new byte
     if (io->bits_set >= 8) {
 
-        int c = fgetc(io->file);
+        int c = io_getc(io);
         // check for end of file
         if (c == EOF) {
             io->eof_reached = 1;
@@ -42,7 +154,7 @@ uint8 read_byte(huffman_io* io) {
     uint8 byte = io->curr_byte;
 
     // read new byte
-    int c = fgetc(io->file);
+    int c = io_getc(io);
     // check for end of file
     if (c == EOF) {
         io->eof_reached = 1;
@@ -60,12 +172,85 @@ uint8 read_byte(huffman_io* io) {
     return byte;
 }
 
+// set bits to the next n (at most 16) bits of input without reading them
+// returns 0 if they are not all in the buffer, then the caller reads bit by bit, which refills it
+int peek_bits(huffman_io* io, int n, unsigned int* bits) {
+
+    // bits left in the current byte are its highest bits
+    int left = 8 - io->bits_set;
+    if (left + 8 * (io->buf_len - io->buf_pos) < (size_t)n) return 0;
+
+    unsigned int window = (unsigned int)io->curr_byte << 24;
+    if (left < n) {
+        window |= (unsigned int)io->buf[io->buf_pos] << (24 - left);
+        if (left + 8 < n) {
+            window |= (unsigned int)io->buf[io->buf_pos + 1] << (16 - left);
+        }
+    }
+    *bits = window >> (32 - n);
+    return 1;
+}
+
+// skip the next n bits of input, these must have been seen by peek_bits
+void skip_bits(huffman_io* io, int n) {
+    int left = 8 - io->bits_set;
+    if (n <= left) {
+        io->curr_byte <<= n;
+        io->bits_set += n;
+        return;
+    }
+
+    // skip whole bytes, then take the byte with the last bits as current byte
+    n -= left;
+    io->buf_pos += (n - 1) / 8;
+    n -= 8 * ((n - 1) / 8);
+    io->curr_byte = io->buf[io->buf_pos++] << n;
+    io->bits_set = n;
+}
+
+// read n (at most 32) bits written by write_bits, most significant first
+unsigned int read_bits(huffman_io* io, int n) {
+    unsigned int bits = 0;
+    if (n > 0 && n <= 16 && peek_bits(io, n, &bits)) {
+        skip_bits(io, n);
+        return bits;
+    }
+    for (int i = 0; i < n; i++) {
+        bits = bits << 1 | read_bit(io);
+    }
+    return bits;
+}
+
+// read up to n bytes from input, only for byte aligned input that is not read bit by bit
+// returns the number of bytes read, this is less than n only at end of input
+size_t read_bytes(huffman_io* io, char* dst, size_t n) {
+
+    size_t total = 0;
+    while (n > 0) {
+        if (io->buf_pos == io->buf_len) {
+            fill_buffer(io);
+            if (io->buf_len == 0) {
+                io->eof_reached = 1;
+                break;
+            }
+        }
+        size_t k = io->buf_len - io->buf_pos;
+        if (k > n) k = n;
+        memcpy(dst, &io->buf[io->buf_pos], k);
+        io->buf_pos += k;
+        dst += k;
+        n -= k;
+        total += k;
+    }
+    return total;
+}
+
 // write one bit to output 
 void write_bit(huffman_io* io, uint8 bit) {
     
     // 8 bits set, output byte
     if (io->bits_set >= 8) {
-        fputc(io->curr_byte, io->file);
+        io_putc(io, io->curr_byte);
         io->bits_set = 0;
     }
 
@@ -81,18 +266,97 @@ void write_byte(huffman_io* io, uint8 byte) {
     io->curr_byte |= byte >> io->bits_set;
 
     // output byte
-    fputc(io->curr_byte, io->file);
+    io_putc(io, io->curr_byte);
 
     // set bits that are not yet written
     io->curr_byte = byte;
 }
 
+// write the n lowest bits of bits, most significant first
+void write_bits(huffman_io* io, unsigned int bits, int n) {
+    while (n > 0) {
+
+        // 8 bits set, output byte
+        if (io->bits_set >= 8) {
+            io_putc(io, io->curr_byte);
+            io->bits_set = 0;
+        }
+
+        // fill the current byte with as many bits as fit
+        int k = 8 - io->bits_set;
+        if (k > n) k = n;
+        n -= k;
+        io->curr_byte = (io->curr_byte << k) | ((bits >> n) & ((1u << k) - 1));
+        io->bits_set += k;
+    }
+}
+
+// write n bytes to output, only for byte aligned output that is not written bit by bit
+void write_bytes(huffman_io* io, const char* src, size_t n) {
+    while (n > 0) {
+        if (io->buf_pos == io->buf_size) {
+            empty_buffer(io);
+        }
+        size_t k = io->buf_size - io->buf_pos;
+        if (k > n) k = n;
+        memcpy(&io->buf[io->buf_pos], src, k);
+        io->buf_pos += k;
+        src += k;
+        n -= k;
+    }
+}
+
+// write byte n times to output, only for byte aligned output that is not written bit by bit
+void write_repeated(huffman_io* io, uint8 byte, size_t n) {
+    while (n > 0) {
+        if (io->buf_pos == io->buf_size) {
+            empty_buffer(io);
+        }
+        size_t k = io->buf_size - io->buf_pos;
+        if (k > n) k = n;
+        memset(&io->buf[io->buf_pos], byte, k);
+        io->buf_pos += k;
+        n -= k;
+    }
+}
+
 void flush(huffman_io* io) {
     
     // check if last byte not filled completely
     if (io->bits_set > 0) {
         // fill last byte with zeroes
         io->curr_byte <<= 8 - io->bits_set;
-        fputc(io->curr_byte, io->file);
+        io_putc(io, io->curr_byte);
     }
+}
+
+
+// map the rest of a regular file in memory for reading, the kernel is told it will be read sequentially
+// returns NULL if the file is not a regular file (e.g. a pipe), is empty or could not be mapped
+// else returns a pointer to the current file position and sets size to the number of bytes left
+const char* map_input(FILE* file, size_t* size) {
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode)) return NULL;
+
+    off_t offset = ftello(file);
+    if (offset < 0 || offset >= st.st_size) return NULL;
+
+    // mapping must start at a page boundary
+    off_t map_offset = offset & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+    size_t map_size = st.st_size - map_offset;
+
+    char* map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fileno(file), map_offset);
+    if (map == MAP_FAILED) return NULL;
+    madvise(map, map_size, MADV_SEQUENTIAL);
+
+    *size = st.st_size - offset;
+    return map + (offset - map_offset);
+}
+
+// unmap input mapped by map_input
+void unmap_input(const char* map, size_t size) {
+    // mapping starts at a page boundary, map may point further in the page
+    size_t offset = (size_t)map % sysconf(_SC_PAGESIZE);
+    munmap((void*)(map - offset), size + offset);
 }
\ No newline at end of file
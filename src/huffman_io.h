@@ -2,6 +2,9 @@
 #define HUFFMAN_IO_H
 
 #include <stdio.h>
+#include "pipeline.h"
+
+#define IO_BUF_SIZE (1 << 16)   // bytes buffered between the coder and the file
 
 typedef unsigned char uint8;
 
@@ -17,18 +20,49 @@ typedef struct huffman_io {
     FILE* file;
     int eof_reached;
 
+    // byte buffer, avoids a library call for every byte
+    uint8* buf;
+    size_t buf_size;    // allocated size of buffer
+    size_t buf_len;     // number of valid bytes in buffer (read mode)
+    size_t buf_pos;     // next byte to read or write
+    int memory;         // buffer is the whole input or output, there is no file
+    unsigned long long bytes_out;   // number of bytes written, if file is NULL bytes are only counted
+
+    // background reader or writer thread, NULL if file is accessed directly
+    Pipeline* pipe;
+
 } huffman_io;
 
 huffman_io init_io(FILE* file, io_mode mode);
+huffman_io init_pipelined_io(FILE* file, io_mode mode);
+huffman_io init_memory_io();
+void reset_memory_io(huffman_io* io);
+void load_memory_io(huffman_io* io, huffman_io* src, size_t n);
+void close_io(huffman_io* io);
+
+// byte aligned access to the buffer, for input or output that is not coded bit by bit
+int io_getc(huffman_io* io);
+void io_putc(huffman_io* io, uint8 byte);
 
 // read
 uint8 read_bit(huffman_io* io);
 uint8 read_byte(huffman_io* io);
+size_t read_bytes(huffman_io* io, char* dst, size_t n);
+unsigned int read_bits(huffman_io* io, int n);
+int peek_bits(huffman_io* io, int n, unsigned int* bits);
+void skip_bits(huffman_io* io, int n);
 
 // write
 void write_bit(huffman_io* io, uint8 bit);
 void write_byte(huffman_io* io, uint8 byte);
+void write_bits(huffman_io* io, unsigned int bits, int n);
+void write_bytes(huffman_io* io, const char* src, size_t n);
+void write_repeated(huffman_io* io, uint8 byte, size_t n);
 void flush(huffman_io* io);
 
+// memory mapped input
+const char* map_input(FILE* file, size_t* size);
+void unmap_input(const char* map, size_t size);
+
 
-#endif //HUFFMAN_IO_H
\ No newline at end of file
+#endif //HUFFMAN_IO_H
@@ -20,4 +20,29 @@ void* safe_calloc_internal(size_t count, size_t size, char* file, unsigned int l
         exit(1);
     }
     return ptr;
-}
\ No newline at end of file
+}
+
+void* safe_realloc_internal(void* ptr, size_t size, char* file, unsigned int line) {
+    ptr = realloc(ptr, size);
+    if (!ptr) {
+        fprintf(stderr, "[%s:%u] Out of memory (%lu bytes)\n", file, line, (unsigned long)size);
+        exit(1);
+    }
+    return ptr;
+}
+
+// read rest of file in memory, sets len to the number of bytes read
+char* read_all(FILE* file, size_t* len) {
+    size_t size = 1 << 16;
+    char* data = (char*)safe_malloc(size);
+    *len = 0;
+    size_t n;
+    while ((n = fread(&data[*len], 1, size - *len, file)) > 0) {
+        *len += n;
+        if (*len == size) {
+            size *= 2;
+            data = (char*)safe_realloc(data, size);
+        }
+    }
+    return data;
+}
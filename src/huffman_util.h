@@ -7,16 +7,20 @@
 #define DEBUG_PRINT do_nothing  // dont do anything
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 
 void do_nothing();
 
 #define safe_malloc(s) safe_malloc_internal(s, __FILE__, __LINE__)
 #define safe_calloc(n, s) safe_calloc_internal(n, s, __FILE__, __LINE__)
+#define safe_realloc(p, s) safe_realloc_internal(p, s, __FILE__, __LINE__)
 
 void* safe_malloc_internal(size_t size, char* file, unsigned int line);
 void* safe_calloc_internal(size_t count, size_t size, char* file, unsigned int line);
+void* safe_realloc_internal(void* ptr, size_t size, char* file, unsigned int line);
 
 char* convert_whitespace(char* str);
+char* read_all(FILE* file, size_t* len);
 
 #endif // HUFFMAN_UTIL_H
\ No newline at end of file
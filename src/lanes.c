@@ -0,0 +1,85 @@
+#include "lanes.h"
+#include "header.h"
+
+// internal functions
+void write_lanes_block(Lanes* lanes);
+
+
+// initialize <n> lanes, the first one uses tree, out is the stream
+// tree of the other lanes are allocated and empty
+void init_lanes(Lanes* lanes, int n, Tree* tree, huffman_io* out) {
+    lanes->n = n;
+    lanes->curr = 0;
+    lanes->symbols = 0;
+    lanes->out = out;
+    lanes->trees[0] = tree;
+    for (int i = 1; i < n; i++) {
+        lanes->trees[i] = init_tree();
+    }
+    for (int i = 0; n > 1 && i < n; i++) {
+        lanes->ios[i] = init_memory_io();
+    }
+}
+
+// returns io of the current lane, this is the stream itself if there is only 1 lane
+huffman_io* lane_io(Lanes* lanes) {
+    return lanes->n > 1 ? &lanes->ios[lanes->curr] : lanes->out;
+}
+
+// go to the lane of the next symbol, the encoder writes the block if it is full
+void next_lane(Lanes* lanes) {
+    if (lanes->n == 1) return;
+    lanes->curr = lanes->curr + 1 == lanes->n ? 0 : lanes->curr + 1;
+    lanes->symbols++;
+    if (lanes->symbols == LANES_BLOCK_SYMBOLS) {
+        write_lanes_block(lanes);
+    }
+}
+
+// write last block and the end of stream marker
+void finish_lanes(Lanes* lanes) {
+    if (lanes->n == 1) return;
+    if (lanes->symbols > 0) {
+        write_lanes_block(lanes);
+    }
+    write_varint(lanes->out, 0);
+}
+
+// write the bits of all lanes to the stream and empty them
+void write_lanes_block(Lanes* lanes) {
+    write_varint(lanes->out, lanes->symbols);
+    for (int i = 0; i < lanes->n; i++) {
+        huffman_io* io = &lanes->ios[i];
+        flush(io);
+        write_varint(lanes->out, io->buf_pos);
+        write_bytes(lanes->out, (char*)io->buf, io->buf_pos);
+        reset_memory_io(io);
+    }
+    lanes->symbols = 0;
+    lanes->curr = 0;
+}
+
+// read the next block from the stream into the lanes
+// returns the number of symbols in it, 0 at the end of the stream
+unsigned int read_lanes_block(Lanes* lanes) {
+    unsigned long long symbols;
+    if (read_varint(lanes->out, &symbols) || symbols == 0 || symbols > LANES_BLOCK_SYMBOLS) return 0;
+
+    for (int i = 0; i < lanes->n; i++) {
+        unsigned long long len;
+        if (read_varint(lanes->out, &len)) return 0;
+        load_memory_io(&lanes->ios[i], lanes->out, len);
+    }
+    lanes->curr = 0;
+    return (unsigned int)symbols;
+}
+
+// free trees and buffers of the lanes, except tree 0
+void free_lanes(Lanes* lanes) {
+    for (int i = 1; i < lanes->n; i++) {
+        free_tree(lanes->trees[i]);
+    }
+    for (int i = 0; lanes->n > 1 && i < lanes->n; i++) {
+        close_io(&lanes->ios[i]);
+    }
+}
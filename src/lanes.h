@@ -0,0 +1,35 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include "huffman.h"
+#include "huffman_io.h"
+
+#define LANES_MAX 8                     // maximum number of lanes
+#define LANES_BLOCK_SYMBOLS (1 << 16)   // symbols in a full block, encoder and decoder go back to lane 0 at each block
+
+// symbols are assigned round robin to <n> lanes, each with its own adaptive tree and bitstream
+// a decoder can walk the trees of all lanes at once, because their walks do not depend on each other
+// bitstreams are interleaved in blocks: number of symbols (varint, 0 ends the stream), then for each lane
+// the number of bytes (varint) followed by its bits, padded to a byte
+// every block starts at lane 0
+// with 1 lane, bits are written directly to the stream without blocks
+typedef struct Lanes {
+
+    int n;          // number of lanes
+    int curr;       // lane of the next symbol
+    unsigned int symbols;   // number of symbols in current block
+
+    Tree* trees[LANES_MAX];     // tree 0 is given by the caller, the others belong to the lanes
+    huffman_io ios[LANES_MAX];  // bits of each lane in memory, not used with 1 lane
+    huffman_io* out;            // stream
+
+} Lanes;
+
+void init_lanes(Lanes* lanes, int n, Tree* tree, huffman_io* out);
+huffman_io* lane_io(Lanes* lanes);
+void next_lane(Lanes* lanes);
+void finish_lanes(Lanes* lanes);
+unsigned int read_lanes_block(Lanes* lanes);
+void free_lanes(Lanes* lanes);
+
+#endif // LANES_H
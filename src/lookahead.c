@@ -0,0 +1,129 @@
+#include <string.h>
+#include "lookahead.h"
+#include "huffman_util.h"
+
+// internal functions
+void refill(Lookahead* la);
+
+// initialize lookahead of <window> bytes on input file
+// if pipelined, a buffered input is read on a separate thread
+void init_lookahead(Lookahead* la, FILE* file, int window, int pipelined) {
+
+    la->window = window;
+    la->history = 0;
+    la->pos = 0;
+    la->eof = 0;
+
+    // if input is a regular file, map it in memory and read it directly from the mapping
+    size_t size = 0;
+    la->map = map_input(file, &size);
+    if (la->map) {
+        la->data = la->map;
+        la->len = size;
+        la->buf = NULL;
+        la->eof = 1;
+        la->whole = 1;
+        return;
+    }
+
+    // else (e.g. a pipe) read it into a buffer
+    la->in = pipelined ? init_pipelined_io(file, READ) : init_io(file, READ);
+    la->buf_size = LOOKAHEAD_BUF_SIZE + window;
+    la->buf = (char*)safe_malloc(la->buf_size);
+    la->data = la->buf;
+    la->len = 0;
+    la->whole = 0;
+}
+
+// initialize lookahead on input that is already in memory, data is not copied or freed
+void init_lookahead_memory(Lookahead* la, const char* data, size_t len, int window) {
+    la->window = window;
+    la->history = 0;
+    la->pos = 0;
+    la->data = data;
+    la->len = len;
+    la->map = NULL;
+    la->buf = NULL;
+    la->eof = 1;
+    la->whole = 1;
+}
+
+// keep <history> bytes before the position in the buffer, for matches with earlier input
+// must be called before the first peek, a mapped input or input in memory is kept anyway
+// the buffer gets room for twice the history, so refills move at most as many bytes as they read
+void lookahead_keep_history(Lookahead* la, size_t history) {
+    la->history = history;
+    if (la->buf) {
+        la->buf_size = LOOKAHEAD_BUF_SIZE + la->window + 2 * history;
+        la->buf = (char*)safe_realloc(la->buf, la->buf_size);
+        la->data = la->buf;
+    }
+}
+
+// move the bytes left and the history before them to the front of the buffer and fill the rest of the buffer
+void refill(Lookahead* la) {
+    size_t keep = la->pos < la->history ? la->pos : la->history;
+    size_t left = la->len - la->pos + keep;
+    memmove(la->buf, &la->buf[la->pos - keep], left);
+    la->pos = keep;
+    la->len = left;
+
+    size_t wanted = la->buf_size - left;
+    size_t read = read_bytes(&la->in, &la->buf[left], wanted);
+    la->len += read;
+    la->eof = read < wanted;    // read_bytes only returns less at end of input
+}
+
+// get pointer to the next bytes to encode
+// avail is set to the number of bytes available, this is <window> unless the end of input is near
+// the pointer stays valid until the next call to lookahead_peek
+const char* lookahead_peek(Lookahead* la, int* avail) {
+    if (!la->eof && la->len - la->pos < (size_t)la->window) {
+        refill(la);
+    }
+    size_t left = la->len - la->pos;
+    *avail = left < (size_t)la->window ? (int)left : la->window;
+    return &la->data[la->pos];
+}
+
+// get pointer to all bytes that can be read without copying, at least 1 unless at end of input
+// used when characters are encoded one by one, so no window is needed
+const char* lookahead_peek_all(Lookahead* la, int* avail) {
+    if (!la->eof && la->pos == la->len) {
+        refill(la);
+    }
+    size_t left = la->len - la->pos;
+    *avail = left < LOOKAHEAD_BUF_SIZE ? (int)left : LOOKAHEAD_BUF_SIZE;
+    return &la->data[la->pos];
+}
+
+// get pointer to the next n bytes without encoding them, avail is set to n unless the end of input is near
+// the buffer grows to n bytes if input is not mapped
+const char* lookahead_peek_n(Lookahead* la, size_t n, size_t* avail) {
+    if (!la->eof && la->len - la->pos < n) {
+        if (la->buf_size < n + la->window + la->history) {
+            la->buf_size = n + la->window + la->history;
+            la->buf = (char*)safe_realloc(la->buf, la->buf_size);
+            la->data = la->buf;
+        }
+        refill(la);
+    }
+    size_t left = la->len - la->pos;
+    *avail = left < n ? left : n;
+    return &la->data[la->pos];
+}
+
+// mark n bytes as encoded
+void lookahead_advance(Lookahead* la, int n) {
+    la->pos += n;
+}
+
+// unmap input or free buffer
+void close_lookahead(Lookahead* la) {
+    if (la->map) {
+        unmap_input(la->map, la->len);
+    } else if (la->buf) {
+        close_io(&la->in);
+        free(la->buf);
+    }
+}
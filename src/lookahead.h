@@ -0,0 +1,42 @@
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+#include <stdio.h>
+#include "huffman_io.h"
+
+#define LOOKAHEAD_BUF_SIZE (1 << 16)    // bytes read at once when input is not mapped
+
+// window on the input that is not yet encoded
+// a regular file is mapped in memory, else the input is read in large chunks in a buffer
+// that is only compacted when fewer than <window> bytes are left, so advancing is O(1)
+typedef struct Lookahead {
+
+    const char* data;   // mapping or buffer
+    size_t pos;         // position of next byte to encode in data
+    size_t len;         // number of valid bytes in data
+
+    int window;         // number of bytes that must be available after pos (unless at end of input)
+    size_t history;     // number of bytes before pos that are kept when the buffer is refilled
+
+    // memory mapped input, NULL if input is buffered
+    const char* map;
+    int whole;          // data holds all of the input from the start, len is its size
+
+    // buffered input
+    char* buf;
+    size_t buf_size;
+    huffman_io in;
+    int eof;
+
+} Lookahead;
+
+void init_lookahead(Lookahead* la, FILE* file, int window, int pipelined);
+void init_lookahead_memory(Lookahead* la, const char* data, size_t len, int window);
+void lookahead_keep_history(Lookahead* la, size_t history);
+const char* lookahead_peek_n(Lookahead* la, size_t n, size_t* avail);
+const char* lookahead_peek(Lookahead* la, int* avail);
+const char* lookahead_peek_all(Lookahead* la, int* avail);
+void lookahead_advance(Lookahead* la, int n);
+void close_lookahead(Lookahead* la);
+
+#endif // LOOKAHEAD_H
@@ -0,0 +1,348 @@
+#include <string.h>
+#include "lz77.h"
+#include "huffman_util.h"
+#include "decode_table.h"
+#include "stats.h"
+
+// speed settings of a compression level for the LZ77 engine
+typedef struct lz77_level {
+    int max_chain;      // earlier positions checked for a match
+    int nice_length;    // length of a match that ends the search
+} lz77_level;
+
+// level 9 checks the most positions, lower levels are faster but find shorter matches
+const lz77_level LZ77_LEVELS[] = {
+    {   0,   0},    // not used
+    {   4,  16},
+    {   8,  16},
+    {  16,  32},
+    {  32,  32},
+    {  64,  64},
+    { 128, 128},
+    { 256, 256},
+    {1024, LZ77_MAX_MATCH},
+    {4096, LZ77_MAX_MATCH}
+};
+
+// internal functions
+void init_lz77(Lz77* lz, int window, int level);
+void free_lz77(Lz77* lz);
+unsigned int hash_position(const char* data);
+void insert_position(Lz77* lz, const char* data, int avail, unsigned long long pos);
+int find_match(Lz77* lz, const char* data, int avail, unsigned long long pos, unsigned int* distance);
+int match_length(const char* match, const char* data, int limit);
+int value_class(unsigned int value, int* extra_bits);
+unsigned int class_value(int cls, huffman_io* io);
+void code_symbol(Tree* tree, huffman_io* io, const char* str, int length);
+Node* decode_symbol(Tree* tree, huffman_io* io);
+
+
+// encode all input in lookahead to out with the LZ77 engine, starting with the header
+// tree is reset and used for literals and lengths, the tree for distances is made here
+void encode_lz77(Tree* tree, huffman_options* opts, Lookahead* la, huffman_io* out) {
+
+    Lz77 lz;
+    init_lz77(&lz, opts->window, opts->level);
+
+    // a match reaches back up to the window and ahead up to LZ77_MAX_MATCH bytes, from the next position with lazy matching
+    la->window = LZ77_MAX_MATCH + 1;
+    lookahead_keep_history(la, lz.window);
+
+    Tree* distances = init_tree();
+    reset_tree(tree);
+    set_max_depth(tree, opts->max_depth);
+    set_max_depth(distances, opts->max_depth);
+
+    // LEN is not used, the header stores 1
+    // the size is known if the whole input is in the lookahead, with dedup it only holds the distinct chunks
+    int sized = la->whole && !opts->dedup;
+    Header header;
+    header.max_chars = 1;
+    header.max_mem = opts->max_mem;
+    header.engine = ENGINE_LZ77;
+    header.flags = (sized ? HEADER_HAS_SIZE : 0) | (opts->max_depth ? HEADER_HAS_MAX_DEPTH : 0) | (opts->dedup ? HEADER_HAS_DEDUP : 0) | HEADER_HAS_WINDOW;
+    header.original_size = sized ? la->len : 0;
+    header.lanes = 1;
+    header.contexts = 0;
+    header.dict_id = 0;
+    header.max_depth = opts->max_depth;
+    header.window = opts->window;
+    write_header(out, &header);
+
+    unsigned long long pos = 0;     // number of characters encoded
+    unsigned long long next_stats = opts->stats_every;
+    int next_length = -1;           // match at the next position, if lazy matching already searched it
+    unsigned int next_distance = 0;
+
+    const char* data;
+    int avail;
+    while ((data = lookahead_peek(la, &avail)) && avail > 0) {
+
+        unsigned int distance = 0;
+        int length;
+        if (next_length >= 0) {
+            length = next_length;
+            distance = next_distance;
+            next_length = -1;
+        } else {
+            length = find_match(&lz, data, avail, pos, &distance);
+        }
+        insert_position(&lz, data, avail, pos);
+
+        // lazy matching: if the match at the next position is longer, code this character as a literal
+        if (opts->lazy && length && length < lz.nice_length && avail > 1) {
+            next_length = find_match(&lz, &data[1], avail - 1, pos + 1, &next_distance);
+            if (next_length > length) {
+                length = 0;
+            } else {
+                next_length = -1;
+            }
+        }
+
+        if (length) {
+            int extra_bits;
+            unsigned int value = length - LZ77_MIN_MATCH;
+            char str[2] = {0, (char)value_class(value, &extra_bits)};
+            code_symbol(tree, out, str, 2);
+            write_bits(out, value, extra_bits);
+
+            value = distance - 1;
+            str[0] = (char)value_class(value, &extra_bits);
+            code_symbol(distances, out, str, 1);
+            write_bits(out, value, extra_bits);
+
+            for (int i = 1; i < length; i++) {
+                insert_position(&lz, &data[i], avail - i, pos + i);
+            }
+        } else {
+            length = 1;
+            code_symbol(tree, out, data, 1);
+        }
+        lookahead_advance(la, length);
+        pos += length;
+
+        if (opts->stats_file && next_stats && pos >= next_stats) {
+            export_tree_stats(opts, tree, NULL, pos);
+            next_stats += opts->stats_every;
+        }
+    }
+
+    // end of input, output nyt path + zero byte
+    write_code(out, tree->nyt);
+    write_byte(out, 0);
+
+    if (opts->stats_file) {
+        export_tree_stats(opts, tree, NULL, pos);
+    }
+
+    free_tree(distances);
+    free_lz77(&lz);
+    flush(out);
+}
+
+// decode a stream of the LZ77 engine, returns number of characters decoded
+// decoded characters are kept in a buffer of twice the window, the older half is written to out when it is full
+// sets corrupted if a symbol is not valid or a match reaches before the start of the stream
+unsigned long long decode_lz77(Tree* tree, Header* header, huffman_io* io, huffman_io* out, huffman_options* opts, int* corrupted) {
+
+    size_t window = (size_t)1 << header->window;
+    size_t size = 2 * window + LZ77_MAX_MATCH;
+    char* buf = (char*)safe_malloc(size);
+    size_t pos = 0;         // next character in buf
+    size_t written = 0;     // characters of buf written to out
+
+    Tree* distances = init_tree();
+    distances->decode = init_decode_table();
+    set_max_depth(distances, header->max_depth);
+
+    unsigned long long decoded = 0;
+    unsigned long long next_stats = opts->stats_every;
+    Node* node;
+    while (!io->eof_reached && (node = decode_symbol(tree, io))) {
+
+        if (pos + LZ77_MAX_MATCH > size) {
+            write_bytes(out, &buf[written], pos - written);
+            memmove(buf, &buf[pos - window], window);
+            pos = window;
+            written = window;
+        }
+
+        if (node->strlength == 1) {
+            buf[pos++] = node->string[0];
+            decoded++;
+        } else {
+            unsigned int length = 0, distance = 0;
+            int cls = (uint8)node->string[1];
+            if (node->strlength == 2 && !node->string[0] && cls < LZ77_LENGTH_CLASSES) {
+                length = class_value(cls, io) + LZ77_MIN_MATCH;
+            }
+            Node* dist_node = length ? decode_symbol(distances, io) : NULL;
+            cls = dist_node ? (uint8)dist_node->string[0] : 0;
+            if (dist_node && dist_node->strlength == 1 && cls < 2 * header->window) {
+                distance = class_value(cls, io) + 1;
+            }
+            if (!distance || distance > decoded || length > LZ77_MAX_MATCH) {
+                *corrupted = 1;
+                break;
+            }
+
+            // a match may overlap the characters it produces, then it is copied one by one
+            char* dst = &buf[pos];
+            const char* src = dst - distance;
+            if (distance >= length) {
+                memcpy(dst, src, length);
+            } else {
+                for (unsigned int i = 0; i < length; i++) dst[i] = src[i];
+            }
+            pos += length;
+            decoded += length;
+        }
+
+        if (opts->stats_file && next_stats && decoded >= next_stats) {
+            export_tree_stats(opts, tree, NULL, decoded);
+            next_stats += opts->stats_every;
+        }
+    }
+    write_bytes(out, &buf[written], pos - written);
+
+    free_tree(distances);
+    free(buf);
+    return decoded;
+}
+
+// allocate the hash chains for a window of 2^window bytes, with the speed settings of level
+void init_lz77(Lz77* lz, int window, int level) {
+    lz->window = 1u << window;
+    lz->max_chain = LZ77_LEVELS[level].max_chain;
+    lz->nice_length = LZ77_LEVELS[level].nice_length;
+    lz->head = (unsigned int*)safe_calloc((size_t)1 << LZ77_HASH_BITS, sizeof(unsigned int));
+    lz->prev = (unsigned int*)safe_calloc(lz->window, sizeof(unsigned int));
+}
+
+void free_lz77(Lz77* lz) {
+    free(lz->head);
+    free(lz->prev);
+}
+
+// hash of the next LZ77_MIN_MATCH characters
+unsigned int hash_position(const char* data) {
+    unsigned int word;
+    memcpy(&word, data, 4);
+    return (word * 2654435761u) >> (32 - LZ77_HASH_BITS);
+}
+
+// add position pos, whose characters start at data, to the chain of its hash
+void insert_position(Lz77* lz, const char* data, int avail, unsigned long long pos) {
+    if (avail < LZ77_MIN_MATCH) return;
+    unsigned int h = hash_position(data);
+    lz->prev[pos & (lz->window - 1)] = lz->head[h];
+    lz->head[h] = (unsigned int)pos;
+}
+
+// find the longest match for the characters at data, which are at position pos, among earlier positions with the same hash
+// returns its length and sets distance, returns 0 if there is no match of at least LZ77_MIN_MATCH characters
+// the characters of the window before data must be in memory, positions are checked from the nearest,
+// and only while each is further back than the one before, as older entries of prev are overwritten
+int find_match(Lz77* lz, const char* data, int avail, unsigned long long pos, unsigned int* distance) {
+    if (avail < LZ77_MIN_MATCH) return 0;
+    int limit = avail < LZ77_MAX_MATCH ? avail : LZ77_MAX_MATCH;
+    unsigned int reach = pos < lz->window ? (unsigned int)pos : lz->window;
+
+    int best = LZ77_MIN_MATCH - 1;
+    unsigned int last = 0;
+    unsigned int candidate = lz->head[hash_position(data)];
+    for (int chain = lz->max_chain; chain > 0; chain--) {
+        unsigned int dist = (unsigned int)pos - candidate;
+        if (dist <= last || dist > reach) break;
+        last = dist;
+
+        // a longer match must also match at the end of the best one so far
+        const char* match = data - dist;
+        if (match[best] == data[best]) {
+            int length = match_length(match, data, limit);
+            if (length > best) {
+                best = length;
+                *distance = dist;
+                if (length >= lz->nice_length || length == limit) break;
+            }
+        }
+        candidate = lz->prev[candidate & (lz->window - 1)];
+    }
+
+    if (best < LZ77_MIN_MATCH || (best == LZ77_MIN_MATCH && *distance > LZ77_FAR_MATCH)) return 0;
+    return best;
+}
+
+// number of equal characters at the start of match and data, at most limit, compared 8 at a time
+int match_length(const char* match, const char* data, int limit) {
+    int n = 0;
+    for (; n + 8 <= limit; n += 8) {
+        unsigned long long a, b;
+        memcpy(&a, &match[n], 8);
+        memcpy(&b, &data[n], 8);
+        if (a != b) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return n + (__builtin_clzll(a ^ b) >> 3);
+#else
+            return n + (__builtin_ctzll(a ^ b) >> 3);
+#endif
+        }
+    }
+    while (n < limit && match[n] == data[n]) n++;
+    return n;
+}
+
+// class of a length or distance value, sets the number of extra bits, which are the lowest bits of value
+int value_class(unsigned int value, int* extra_bits) {
+    if (value < 4) {
+        *extra_bits = 0;
+        return (int)value;
+    }
+    int k = 31 - __builtin_clz(value);
+    *extra_bits = k - 1;
+    return 2 * k + ((value >> (k - 1)) & 1);
+}
+
+// value of a class, the extra bits are read from io
+unsigned int class_value(int cls, huffman_io* io) {
+    if (cls < 4) return (unsigned int)cls;
+    int k = cls / 2;
+    return (unsigned int)(2 | (cls & 1)) << (k - 1) | read_bits(io, k - 1);
+}
+
+// output the code of the leaf of str and update tree, a new string follows the nyt path
+void code_symbol(Tree* tree, huffman_io* io, const char* str, int length) {
+    Node* node = tree_find_node(tree, str, length);
+    if (node) {
+        write_code(io, node);
+    } else {
+        node = tree->nyt;
+        write_code(io, node);
+        write_byte(io, (uint8)length);
+        for (int i = 0; i < length; i++) {
+            write_byte(io, (uint8)str[i]);
+        }
+    }
+    update_tree(tree, node, str, length);
+}
+
+// decode the next symbol of tree and update tree, returns its leaf, or NULL at the end of the stream
+Node* decode_symbol(Tree* tree, huffman_io* io) {
+    Node* node = decode_prefix(tree, io);
+    while (node->left) {
+        node = read_bit(io) ? node->right : node->left;
+    }
+    if (node != tree->nyt) {
+        update_tree(tree, node, NULL, 0);
+        return node;
+    }
+
+    uint8 length = read_byte(io);
+    if (length == 0) return NULL;
+    char str[length];
+    for (int i = 0; i < length; i++) {
+        str[i] = (char)read_byte(io);
+    }
+    update_tree(tree, node, str, length);
+    return tree_last_added(tree);
+}
@@ -0,0 +1,44 @@
+#ifndef LZ77_H
+#define LZ77_H
+
+#include "huffman.h"
+#include "huffman_io.h"
+#include "lookahead.h"
+#include "header.h"
+
+#define LZ77_MIN_WINDOW 10      // bounds for log2 of the window size
+#define LZ77_MAX_WINDOW 24
+#define LZ77_MIN_MATCH 4        // shorter matches are coded as literals
+#define LZ77_MAX_MATCH 1024     // longer matches are split
+#define LZ77_LENGTH_CLASSES 20  // classes of match lengths, see below
+#define LZ77_FAR_MATCH (1 << 14)    // matches of LZ77_MIN_MATCH bytes further back cost more than their literals
+#define LZ77_HASH_BITS 16       // the hash of the next LZ77_MIN_MATCH bytes selects a chain of earlier positions
+
+// LZ77 engine: input is coded as literals and matches, a match repeats <length> bytes that start
+// <distance> bytes back, within the last 2^window bytes, and may overlap the bytes it produces
+// symbols are coded with 2 adaptive trees, new symbols with the nyt path, their length and characters as in
+// the string engine:
+// - the literal tree has a leaf for each character (a string of 1 character) and each class of match lengths
+//   (a string of 2 characters, 0 and the class), a match starts with the code of its length class
+// - the distance tree has a leaf for each class of distances (a string of 1 character, the class),
+//   its code follows the extra bits of the length
+// lengths minus LZ77_MIN_MATCH and distances minus 1 are split in a class and extra bits: values below 4 are
+// classes 0 to 3 without extra bits, values with highest bit k >= 2 are in class 2k if the bit below is 0,
+// else in class 2k+1, followed by the k-1 lowest bits, most significant first
+// the stream ends with the nyt path of the literal tree and length 0
+typedef struct Lz77 {   // match finder of the encoder
+
+    unsigned int window;    // size of the window, a power of 2
+    int max_chain;      // number of earlier positions checked for a match
+    int nice_length;    // a match of this length is taken without checking further positions
+
+    // positions are stored modulo 2^32, the distance to a position is checked before it is used
+    unsigned int* head;     // last position with each hash
+    unsigned int* prev;     // for each position in the window, the previous position with the same hash
+
+} Lz77;
+
+void encode_lz77(Tree* tree, huffman_options* opts, Lookahead* la, huffman_io* out);
+unsigned long long decode_lz77(Tree* tree, Header* header, huffman_io* io, huffman_io* out, huffman_options* opts, int* corrupted);
+
+#endif // LZ77_H
@@ -3,16 +3,28 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <time.h>
+#include <unistd.h>
 #include "huffman.h"
+#include "batch.h"
+#include "tune.h"
+#include "lanes.h"
+#include "context.h"
+#include "dict.h"
+#include "daemon.h"
+#include "checkpoint.h"
+#include "lz77.h"
+#include "rle.h"
 
 #define CLOCKS_PER_MS 1000
 
 void print_usage(int disp_table) {
-    printf("\nUsage: persen [-c LEN,MEM | -d] [-i INPUTFILE] [-o OUTPUTFILE] [-h]\n\n");
+    printf("\nUsage: persen [-c LEN,MEM | -c auto[,OBJECTIVE] [-1..-9] [-l LAZY] [-L DEPTH] [-s | -a] [-n LANES | -C CLASSES] [-w BITS] [-r] [-u] [-e] | -d [-m MEM]] [-i INPUTFILE] [-o OUTPUTFILE] [-b LIST [-j THREADS]] [-x STATSFILE [-X MIB]] [-P DICTFILE] [-D SOCKET [-j THREADS] | -S SOCKET] [-k | -A | -R CHECKPOINT] [-p] [-h]\n\n");
     printf("\t-c: compress a file using huffman coding, this option requires 2 additional arguments: LEN and MEM\n");
     printf("\t\tLEN is the upper bound for number of characters in one leaf node, this must be an integer between 1 and 255\n");
     printf("\t\tMEM is the index used to look up the maximum memory usage, this must be an integer between 0 and 9\n");
-    printf("\t\tuse option -h to display lookup table\n\n");
+    printf("\t\tuse option -h to display lookup table\n");
+    printf("\t\twith -c auto, LEN and MEM are chosen by compressing the first %i KiB of input with several values of LEN\n", TUNE_SAMPLE_SIZE / 1024);
+    printf("\t\tOBJECTIVE is speed, ratio or balanced (default)\n\n");
     if (disp_table) {
         printf("\t\tmax memory lookup table:\n");
         printf("\t\t[ 0 | 75 KiB  ]\n");
@@ -26,9 +38,41 @@ void print_usage(int disp_table) {
         printf("\t\t[ 8 | 500 MiB ]\n");
         printf("\t\t[ 9 | 1 GiB   ]\n\n");
     }
+    printf("\t-1 .. -9: compression level, caps the number of characters probed at each position at 8, 16, 16, 24, 32, 48, 64, 128\n");
+    printf("\t\tor 255 (-9, default), higher levels are slower but do not always compress better\n");
+    printf("\t\t-1 and -2 only make new strings of 1, 2, 4, 8, ... characters, -7 and up also count strings found in the tree\n");
+    printf("\t-l: lazy matching, before encoding a string check if a longer known string starts up to LAZY (1 or 2) characters later\n");
+    printf("\t-L: bound the length of codes to DEPTH (%i to %i) bits, by halving all weights when a code could get longer\n", MIN_MAX_DEPTH, MAX_MAX_DEPTH);
+    printf("\t-s: choose strings by their estimated cost in bits per character under the current tree\n");
+    printf("\t-a: count strings on a separate thread that runs ahead of the coder, only if INPUTFILE is a regular file\n");
+    printf("\t-n: code symbols round robin with LANES (1 to %i) independent trees, default is 1\n", LANES_MAX);
+    printf("\t\tlanes only make decompression faster when leaves hold long strings (high LEN), with short strings it gets slower\n");
+    printf("\t-C: code each string first with a tree for the previous character, hashed to CLASSES (a power of 2 up to %i) trees\n", CONTEXT_MAX_CLASSES);
+    printf("\t-w, --window: code repeated strings as matches of up to %i bytes within the last 2^BITS (%i to %i) bytes of input (LZ77)\n", LZ77_MAX_MATCH, LZ77_MIN_WINDOW, LZ77_MAX_WINDOW);
+    printf("\t\tother characters are coded one by one and LEN is not used, with -l a match is dropped if the next one is longer\n");
+    printf("\t\tthe decoder keeps 2^(BITS+1) bytes of output in memory\n");
+    printf("\t-r, --runs: code each run of %i to %i equal characters with one leaf, followed by the character and the length\n", RLE_MIN_RUN, RLE_MAX_RUN);
+    printf("\t-u, --dedup: read all input, split it into chunks at positions that depend on the content, and code every distinct chunk once\n");
+    printf("\t\trepeated regions of a few KiB or more are then only coded once, the decoder keeps the distinct chunks in memory\n");
+    printf("\t-e, --adaptive: probe fewer characters than LEN at each position while the strings found and chosen are short, and more\n");
+    printf("\t\tup to LEN while they are long, the output is the same on every run and is decompressed as usual\n");
     printf("\t-d: decompress a file, no further arguments required\n");
+    printf("\t-m: decompress only if the file was compressed with a MEM index of at most MEM\n");
     printf("\t-i: specify input file, if not specified, standard input will be used\n");
     printf("\t-o: specify output file, if not specified, standard output will be used\n");
+    printf("\t-b: compress many files, LIST is a directory or a file with one file name per line (- for standard input)\n");
+    printf("\t\teach file is compressed to a file with the same name followed by %s, requires -c\n", BATCH_EXTENSION);
+    printf("\t-j: number of threads used by -b, default is the number of processors\n");
+    printf("\t-x: write statistics of the huffman tree to STATSFILE at the end of input, as json lines or as csv if the name ends in .csv\n");
+    printf("\t-X: also write statistics every MIB mebibytes of input, requires -x\n");
+    printf("\t-P: prime the trees with the strings in DICTFILE, one per line, the same file is required to decompress\n");
+    printf("\t-D: run as a daemon that compresses and decompresses requests sent to the unix socket SOCKET, with THREADS worker threads\n");
+    printf("\t-S: send input to the daemon listening on SOCKET instead of coding it in this process, requires -c or -d\n");
+    printf("\t-k, --checkpoint: save the state of the encoder to OUTPUTFILE%s, so more input can be appended later\n", CHECKPOINT_EXTENSION);
+    printf("\t-A, --append: compress input to the end of the stream in OUTPUTFILE, continuing from OUTPUTFILE%s with its settings\n", CHECKPOINT_EXTENSION);
+    printf("\t-R, --resume: decompress only what was appended after CHECKPOINT was saved, the input must be a file\n");
+    printf("\t\t-k and -A require -o, checkpoints cannot be used with -n, -C, -b, -S or -D\n");
+    printf("\t-p: read input and write output on separate threads, overlapping file io with coding\n");
     printf("\t-h: display this help with memory lookup table and exit\n\n");
     exit(!disp_table);
 }
@@ -36,28 +80,49 @@ void print_usage(int disp_table) {
 int main(int argc, char **argv) {
 
     int cflag = 0;      // compress input file
-    int max_chars = 0;  // max characters per node
-    int max_mem = 0;    // max memory to be allocated
+    huffman_options opts = init_options();  // max characters per node, max memory, ...
     int dflag = 0;      // decompress input file
     int iflag = 0;      // input file is given
     int oflag = 0;      // output file is given
     int tflag = 0;      // output execution time
+    char* batch_list = NULL;    // compress all files in list or directory
+    long stats_mib = 0;     // interval of statistics export in MiB
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);  // number of threads for batch and daemon mode
+    char* daemon_socket = NULL;     // serve requests on this socket
+    char* client_socket = NULL;     // send request to the daemon on this socket
+    char* output_name = NULL;   // output file, opened after all options are known
+    int kflag = 0;      // save checkpoint next to output file
     FILE* inputfile = stdin;
     FILE* outputfile = stdout;
 
     int opt;
+    static struct option long_options[] = {
+        {"checkpoint", no_argument, NULL, 'k'},
+        {"append", no_argument, NULL, 'A'},
+        {"resume", required_argument, NULL, 'R'},
+        {"dedup", no_argument, NULL, 'u'},
+        {"window", required_argument, NULL, 'w'},
+        {"runs", no_argument, NULL, 'r'},
+        {"adaptive", no_argument, NULL, 'e'},
+        {NULL, 0, NULL, 0}
+    };
 
-    while ((opt = getopt(argc, argv, "c:di:o:th")) != -1) {
+    while ((opt = getopt_long(argc, argv, "c:dm:l:L:san:C:w:ruei:o:b:j:x:X:P:D:S:kAR:pth123456789", long_options, NULL)) != -1) {
         switch (opt) {
             case 'c': {
                 char* arg1 = strtok(optarg, ",");
                 char* arg2 = strtok(NULL, ",");
 
-                if (arg1 && arg2) {
-                    max_chars = (int)strtol(arg1, NULL, 10);
-                    max_mem = (int)strtol(arg2, NULL, 10);
+                if (arg1 && strcmp(arg1, "auto") == 0) {
+                    // choose LEN and MEM from a sample, optionally for a given objective
+                    opts.max_chars = 0;
+                    opts.objective = arg2 ? parse_objective(arg2) : TUNE_BALANCED;
+                    cflag = opts.objective >= 0;
+                } else if (arg1 && arg2) {
+                    opts.max_chars = (int)strtol(arg1, NULL, 10);
+                    opts.max_mem = (int)strtol(arg2, NULL, 10);
                     
-                    if (max_chars > 0 && max_chars < 256 && max_mem >= 0 && max_mem < 10) {
+                    if (opts.max_chars > 0 && opts.max_chars < 256 && opts.max_mem >= 0 && opts.max_mem < 10) {
                         cflag = 1;
                     }
                 } 
@@ -72,6 +137,86 @@ int main(int argc, char **argv) {
                 dflag = 1;
                 break;
             
+            case 'm': {
+                char* end;
+                opts.mem_limit = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || opts.mem_limit < 0 || opts.mem_limit > 9) {
+                    fprintf(stderr, "Error: incorrect argument for -m option\n");
+                    print_usage(0);
+                }
+                break;
+            }
+            
+            case 'l': {
+                char* end;
+                opts.lazy = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || opts.lazy < 0 || opts.lazy > 2) {
+                    fprintf(stderr, "Error: incorrect argument for -l option\n");
+                    print_usage(0);
+                }
+                break;
+            }
+            
+            case 'L': {
+                char* end;
+                opts.max_depth = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || opts.max_depth < MIN_MAX_DEPTH || opts.max_depth > MAX_MAX_DEPTH) {
+                    fprintf(stderr, "Error: incorrect argument for -L option\n");
+                    print_usage(0);
+                }
+                break;
+            }
+            
+            case 's':
+                opts.cost = 1;
+                break;
+            
+            case 'a':
+                opts.analysis = 1;
+                break;
+            
+            case 'n': {
+                char* end;
+                opts.lanes = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || opts.lanes < 1 || opts.lanes > LANES_MAX) {
+                    fprintf(stderr, "Error: incorrect argument for -n option\n");
+                    print_usage(0);
+                }
+                break;
+            }
+            
+            case 'C': {
+                char* end;
+                opts.contexts = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || opts.contexts < 1 || opts.contexts > CONTEXT_MAX_CLASSES || (opts.contexts & (opts.contexts - 1))) {
+                    fprintf(stderr, "Error: incorrect argument for -C option\n");
+                    print_usage(0);
+                }
+                break;
+            }
+            
+            case 'w': {
+                char* end;
+                opts.window = (int)strtol(optarg, &end, 10);
+                if (*end != '\0' || opts.window < LZ77_MIN_WINDOW || opts.window > LZ77_MAX_WINDOW) {
+                    fprintf(stderr, "Error: incorrect argument for -w option\n");
+                    print_usage(0);
+                }
+                break;
+            }
+            
+            case 'r':
+                opts.rle = 1;
+                break;
+
+            case 'u':
+                opts.dedup = 1;
+                break;
+
+            case 'e':
+                opts.adaptive = 1;
+                break;
+
             case 'i':
                 if (!(inputfile = fopen(optarg, "rb"))) {
                     fprintf(stderr, "Error: could not open input file\n");
@@ -81,23 +226,88 @@ int main(int argc, char **argv) {
                 break;
             
             case 'o':
-                if (!(outputfile = fopen(optarg, "wb"))) {
-                    fprintf(stderr, "Error: could not open output file\n");
+                output_name = optarg;
+                oflag = 1;
+                break;
+            
+            case 'b':
+                batch_list = optarg;
+                break;
+            
+            case 'j':
+                threads = (int)strtol(optarg, NULL, 10);
+                if (threads < 1) {
+                    fprintf(stderr, "Error: number of threads must be at least 1\n");
+                    print_usage(0);
+                }
+                break;
+            
+            case 'x': {
+                if (!(opts.stats_file = fopen(optarg, "w"))) {
+                    fprintf(stderr, "Error: could not open statistics file\n");
                     exit(1);
                 }
-                oflag = 1;
+                size_t len = strlen(optarg);
+                opts.stats_csv = len >= 4 && strcmp(&optarg[len-4], ".csv") == 0;
+                break;
+            }
+            
+            case 'X': {
+                char* end;
+                stats_mib = strtol(optarg, &end, 10);
+                if (*end != '\0' || stats_mib < 1) {
+                    fprintf(stderr, "Error: incorrect argument for -X option\n");
+                    print_usage(0);
+                }
+                opts.stats_every = (unsigned long long)stats_mib << 20;
+                break;
+            }
+            
+            case 'P':
+                if (!(opts.dict = load_dictionary(optarg))) {
+                    fprintf(stderr, "Error: could not open dictionary file\n");
+                    exit(1);
+                }
+                break;
+            
+            case 'D':
+                daemon_socket = optarg;
+                break;
+            
+            case 'S':
+                client_socket = optarg;
+                break;
+            
+            case 'k':
+                kflag = 1;
+                break;
+            
+            case 'A':
+                opts.append = 1;
+                break;
+            
+            case 'R':
+                opts.checkpoint = optarg;
+                break;
+            
+            case 'p':
+                opts.pipelined = 1;
                 break;
             
             case 't':
                 tflag = 1;
                 break;
             
+            case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+                opts.level = opt - '0';
+                break;
+            
             case 'h':
                 print_usage(1);
                 break;
 
             case '?':
-                if (optopt == 'c' || optopt == 'i' || optopt == 'o') {
+                if (optopt == 'c' || optopt == 'm' || optopt == 'l' || optopt == 'L' || optopt == 'n' || optopt == 'C' || optopt == 'w' || optopt == 'i' || optopt == 'o' || optopt == 'b' || optopt == 'j' || optopt == 'x' || optopt == 'X' || optopt == 'P' || optopt == 'D' || optopt == 'S' || optopt == 'R') {
                     fprintf(stderr, "Error: option -%c requires an argument\n", optopt);
                 } else {
                     fprintf(stderr, "Error: unknown option\n");
@@ -112,30 +322,134 @@ int main(int argc, char **argv) {
 
     clock_t start = clock() / CLOCKS_PER_MS;
 
+    if (opts.cost && opts.analysis) {
+        fprintf(stderr, "Error: cannot set both -s and -a option\n");
+        print_usage(0);
+    }
+
+    if (stats_mib && !opts.stats_file) {
+        fprintf(stderr, "Error: -X requires -x\n");
+        print_usage(0);
+    }
+    if (batch_list && opts.stats_file) {
+        fprintf(stderr, "Error: cannot set both -b and -x option\n");
+        print_usage(0);
+    }
+
+    if (opts.dedup && (kflag || opts.append || client_socket || daemon_socket)) {
+        fprintf(stderr, "Error: -u cannot be combined with -k, -A, -S or -D\n");
+        print_usage(0);
+    }
+
+    if (opts.window && (opts.cost || opts.analysis || opts.lanes > 1 || opts.contexts || opts.dict || kflag || opts.append || client_socket || daemon_socket)) {
+        fprintf(stderr, "Error: -w cannot be combined with -s, -a, -n, -C, -P, -k, -A, -S or -D\n");
+        print_usage(0);
+    }
+
+    if (opts.rle && (opts.lanes > 1 || opts.contexts || opts.window || kflag || opts.append || client_socket || daemon_socket)) {
+        fprintf(stderr, "Error: -r cannot be combined with -n, -C, -w, -k, -A, -S or -D\n");
+        print_usage(0);
+    }
+
+    if (opts.adaptive && (opts.window || kflag || opts.append)) {
+        fprintf(stderr, "Error: -e cannot be combined with -w, -k or -A\n");
+        print_usage(0);
+    }
+
+    if (opts.contexts && opts.lanes > 1) {
+        fprintf(stderr, "Error: cannot set both -n and -C option\n");
+        print_usage(0);
+    }
+
+    // the checkpoint of a stream is saved next to it
+    char checkpoint_name[output_name ? strlen(output_name) + sizeof(CHECKPOINT_EXTENSION) : 1];
+    if ((kflag || opts.append) && (opts.checkpoint || !oflag || opts.lanes > 1 || opts.contexts || batch_list || client_socket || daemon_socket)) {
+        fprintf(stderr, "Error: -k and -A require -o, and cannot be combined with -R, -n, -C, -b, -S or -D\n");
+        print_usage(0);
+    } else if (kflag || opts.append) {
+        strcpy(checkpoint_name, output_name);
+        strcat(checkpoint_name, CHECKPOINT_EXTENSION);
+        opts.checkpoint = checkpoint_name;
+    }
+    if (opts.append && (cflag || dflag)) {
+        fprintf(stderr, "Error: -A continues with the settings of the checkpoint, cannot set -c or -d\n");
+        print_usage(0);
+    }
+    if (opts.checkpoint && !opts.append && !kflag && (!dflag || opts.pipelined || client_socket)) {
+        fprintf(stderr, "Error: -R requires -d, and cannot be combined with -p or -S\n");
+        print_usage(0);
+    }
+
+    if (daemon_socket && (cflag || dflag || client_socket || batch_list || iflag || oflag || opts.stats_file)) {
+        fprintf(stderr, "Error: -D cannot be combined with -c, -d, -S, -b, -i, -o or -x\n");
+        print_usage(0);
+    }
+    if (client_socket && (batch_list || opts.stats_file || opts.pipelined || opts.analysis)) {
+        fprintf(stderr, "Error: -S cannot be combined with -b, -x, -p or -a\n");
+        print_usage(0);
+    }
+
     if (cflag && dflag) {
         fprintf(stderr, "Error: cannot set both -c and -d option\n");
         print_usage(0);
-    } else if (cflag) {
-        compress(max_chars, max_mem, inputfile, outputfile);
+    }
+    if (batch_list && (!cflag || iflag || oflag)) {
+        fprintf(stderr, "Error: -b requires -c and cannot be combined with -i or -o\n");
+        print_usage(0);
+    }
+    if (!daemon_socket && !cflag && !dflag && !opts.append) {
+        fprintf(stderr, "Error: must set either -c or -d option\n");
+        print_usage(0);
+    }
+
+    // all options are checked before the output file is opened, so an invalid command line does not truncate it
+    // an append continues the stream in the output file, so it is not truncated
+    if (output_name && !(outputfile = fopen(output_name, opts.append ? "r+b" : "wb"))) {
+        fprintf(stderr, "Error: could not open output file\n");
+        exit(1);
+    }
+
+    if (daemon_socket) {
+        if (threads < 1) threads = 1;
+        run_daemon(&opts, daemon_socket, threads);
+        exit(1);
+    } else if (batch_list) {
+        if (threads < 1) threads = 1;
+        int failed = compress_batch(&opts, batch_list, threads);
+
+        if (tflag) {
+            clock_t end = clock() / CLOCKS_PER_MS;
+            printf("compression time: %ld ms (cpu)\n", end-start);
+        }
+        if (failed) exit(1);
+    } else if (client_socket && (cflag || dflag)) {
+        int failed = run_client(&opts, client_socket, cflag ? 'c' : 'd', inputfile, outputfile);
+
+        if (tflag) {
+            clock_t end = clock() / CLOCKS_PER_MS;
+            printf("%s time: %ld ms (client)\n", cflag ? "compression" : "decompression", end-start);
+        }
+        if (failed) exit(1);
+    } else if (cflag || opts.append) {
+        compress(&opts, inputfile, outputfile);
 
         if (tflag) {
             clock_t end = clock() / CLOCKS_PER_MS;
             printf("compression time: %ld ms\n", end-start);
         }
-    } else if (dflag) {
-        decompress(inputfile, outputfile);
+    } else {
+        decompress(&opts, inputfile, outputfile);
 
         if (tflag) {
             clock_t end = clock() / CLOCKS_PER_MS;
             printf("decompression time: %ld ms\n", end-start);
         }
-    } else {
-        fprintf(stderr, "Error: must set either -c or -d option\n");
-        print_usage(0);
     }
 
     if (iflag) fclose(inputfile);
     if (oflag) fclose(outputfile);
+    if (opts.stats_file) fclose(opts.stats_file);
+    if (opts.dict) free_dictionary(opts.dict);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include <string.h>
+#include "pipeline.h"
+#include "huffman_util.h"
+
+// internal functions
+Pipeline* init_pipeline(FILE* file, int writing);
+void* reader_thread(void* arg);
+void* writer_thread(void* arg);
+void publish_buffer(Pipeline* pipe);
+
+
+// start a thread that reads the file ahead of the coder
+Pipeline* start_reader(FILE* file) {
+    Pipeline* pipe = init_pipeline(file, 0);
+    if (pthread_create(&pipe->thread, NULL, reader_thread, pipe)) {
+        fprintf(stderr, "[%s:%i] could not start reader thread\n", __FILE__, __LINE__);
+        exit(1);
+    }
+    return pipe;
+}
+
+// start a thread that writes buffers filled by the coder to the file
+Pipeline* start_writer(FILE* file) {
+    Pipeline* pipe = init_pipeline(file, 1);
+    if (pthread_create(&pipe->thread, NULL, writer_thread, pipe)) {
+        fprintf(stderr, "[%s:%i] could not start writer thread\n", __FILE__, __LINE__);
+        exit(1);
+    }
+    return pipe;
+}
+
+Pipeline* init_pipeline(FILE* file, int writing) {
+    Pipeline* pipe = (Pipeline*)safe_calloc(1, sizeof(Pipeline));     // calloc sets everything to 0
+    pipe->file = file;
+    pipe->writing = writing;
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->cond, NULL);
+    for (int i = 0; i < PIPELINE_BUFFERS; i++) {
+        pipe->bufs[i] = (char*)safe_malloc(PIPELINE_BUF_SIZE);
+    }
+    return pipe;
+}
+
+// fill buffers with input until end of file is reached or the coder stops reading
+void* reader_thread(void* arg) {
+    Pipeline* pipe = (Pipeline*)arg;
+
+    int eof = 0;
+    while (!eof) {
+
+        // wait for an empty buffer
+        pthread_mutex_lock(&pipe->lock);
+        while (pipe->count == PIPELINE_BUFFERS && !pipe->stop) {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        int i = pipe->head;
+        int stop = pipe->stop;
+        pthread_mutex_unlock(&pipe->lock);
+        if (stop) break;
+
+        // fill buffer without holding the lock, the coder never touches buffer head
+        size_t n = fread(pipe->bufs[i], sizeof(char), PIPELINE_BUF_SIZE, pipe->file);
+        eof = n < PIPELINE_BUF_SIZE;    // fread only returns less on end of file or error
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->lens[i] = n;
+        pipe->head = (pipe->head + 1) % PIPELINE_BUFFERS;
+        pipe->count++;
+        pipe->done = eof;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    return NULL;
+}
+
+// write filled buffers to the file until the coder is done
+void* writer_thread(void* arg) {
+    Pipeline* pipe = (Pipeline*)arg;
+
+    while (1) {
+
+        // wait for a filled buffer
+        pthread_mutex_lock(&pipe->lock);
+        while (pipe->count == 0 && !pipe->done) {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+        if (pipe->count == 0) {
+            // done and all buffers written
+            pthread_mutex_unlock(&pipe->lock);
+            break;
+        }
+        int i = pipe->tail;
+        pthread_mutex_unlock(&pipe->lock);
+
+        fwrite(pipe->bufs[i], sizeof(char), pipe->lens[i], pipe->file);
+
+        // hand buffer back to the coder
+        pthread_mutex_lock(&pipe->lock);
+        pipe->tail = (pipe->tail + 1) % PIPELINE_BUFFERS;
+        pipe->count--;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    fflush(pipe->file);
+    return NULL;
+}
+
+// read up to n bytes from the buffers filled by the reader thread
+// returns the number of bytes read, this is less than n only at end of file
+size_t pipeline_read(Pipeline* pipe, char* dst, size_t n) {
+
+    size_t total = 0;
+    while (n > 0) {
+
+        // current buffer is empty, take the next one
+        if (pipe->curr_pos == pipe->curr_len) {
+
+            pthread_mutex_lock(&pipe->lock);
+            if (pipe->curr) {
+                // hand current buffer back to the reader thread
+                pipe->tail = (pipe->tail + 1) % PIPELINE_BUFFERS;
+                pipe->count--;
+                pipe->curr = NULL;
+                pthread_cond_broadcast(&pipe->cond);
+            }
+            while (pipe->count == 0 && !pipe->done) {
+                pthread_cond_wait(&pipe->cond, &pipe->lock);
+            }
+            if (pipe->count == 0) {
+                // end of file reached and all buffers read
+                pthread_mutex_unlock(&pipe->lock);
+                break;
+            }
+            pipe->curr = pipe->bufs[pipe->tail];
+            pipe->curr_len = pipe->lens[pipe->tail];
+            pipe->curr_pos = 0;
+            pthread_mutex_unlock(&pipe->lock);
+            continue;   // buffer may be empty
+        }
+
+        size_t k = pipe->curr_len - pipe->curr_pos;
+        if (k > n) k = n;
+        memcpy(dst, &pipe->curr[pipe->curr_pos], k);
+        pipe->curr_pos += k;
+        dst += k;
+        n -= k;
+        total += k;
+    }
+    return total;
+}
+
+// copy n bytes to the buffers drained by the writer thread
+void pipeline_write(Pipeline* pipe, const char* src, size_t n) {
+
+    while (n > 0) {
+
+        // no current buffer, wait for an empty one
+        if (!pipe->curr) {
+            pthread_mutex_lock(&pipe->lock);
+            while (pipe->count == PIPELINE_BUFFERS) {
+                pthread_cond_wait(&pipe->cond, &pipe->lock);
+            }
+            pipe->curr = pipe->bufs[pipe->head];
+            pipe->curr_len = 0;
+            pthread_mutex_unlock(&pipe->lock);
+        }
+
+        size_t k = PIPELINE_BUF_SIZE - pipe->curr_len;
+        if (k > n) k = n;
+        memcpy(&pipe->curr[pipe->curr_len], src, k);
+        pipe->curr_len += k;
+        src += k;
+        n -= k;
+
+        if (pipe->curr_len == PIPELINE_BUF_SIZE) {
+            publish_buffer(pipe);
+        }
+    }
+}
+
+// hand the current buffer to the writer thread
+void publish_buffer(Pipeline* pipe) {
+    pthread_mutex_lock(&pipe->lock);
+    pipe->lens[pipe->head] = pipe->curr_len;
+    pipe->head = (pipe->head + 1) % PIPELINE_BUFFERS;
+    pipe->count++;
+    pipe->curr = NULL;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+// stop the thread, for a writer all data is written first
+// frees all memory allocated by the pipeline
+void stop_pipeline(Pipeline* pipe) {
+    if (!pipe) return;
+
+    if (pipe->writing && pipe->curr && pipe->curr_len > 0) {
+        publish_buffer(pipe);
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->done = 1;
+    pipe->stop = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+    pthread_join(pipe->thread, NULL);
+
+    pthread_mutex_destroy(&pipe->lock);
+    pthread_cond_destroy(&pipe->cond);
+    for (int i = 0; i < PIPELINE_BUFFERS; i++) {
+        free(pipe->bufs[i]);
+    }
+    free(pipe);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#define PIPELINE_BUF_SIZE (1 << 20)    // 1 MiB per buffer
+#define PIPELINE_BUFFERS 3             // triple buffering
+
+// background thread that reads a file into, or writes a file from, a ring of large buffers
+// the coder thread only copies bytes from or to the buffers, so file io overlaps with coding
+typedef struct Pipeline {
+
+    FILE* file;
+    int writing;    // 1 if the thread writes to file, 0 if it reads from file
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    // signalled when a buffer is filled or emptied
+
+    // ring of buffers, buffers tail .. tail+count-1 are filled
+    char* bufs[PIPELINE_BUFFERS];
+    size_t lens[PIPELINE_BUFFERS];
+    int head;   // next buffer to be filled
+    int tail;   // next buffer to be emptied
+    int count;  // number of filled buffers
+    int done;   // reader: end of file reached, writer: no more buffers will be filled
+    int stop;   // reader: coder thread stopped reading, thread must exit
+
+    // buffer currently used by the coder thread
+    char* curr;
+    size_t curr_len;
+    size_t curr_pos;
+
+} Pipeline;
+
+Pipeline* start_reader(FILE* file);
+Pipeline* start_writer(FILE* file);
+
+size_t pipeline_read(Pipeline* pipe, char* dst, size_t n);
+void pipeline_write(Pipeline* pipe, const char* src, size_t n);
+
+void stop_pipeline(Pipeline* pipe);
+
+#endif // PIPELINE_H
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include <string.h>
+#include "probe.h"
+#include "huffman_util.h"
+
+
+// start at the bound, the first period probes as without a limit
+void init_probe_limit(Probe_limit* p, int bound) {
+    p->bound = bound;
+    p->limit = bound;
+    p->symbols = 0;
+    memset(p->lengths, 0, sizeof(p->lengths));
+}
+
+// number of characters to probe for the next symbol
+int probe_depth(Probe_limit* p) {
+    return p->symbols % PROBE_SAMPLE ? p->limit : p->bound;
+}
+
+// count a coded symbol, hit is the length of the longest string found in the tree (0 if none)
+// and length the number of characters coded, the longer one is kept if the symbol is a sample
+// at the end of each period, the limit is set from the sampled lengths
+void probe_limit_update(Probe_limit* p, int hit, int length) {
+    if (p->symbols++ % PROBE_SAMPLE == 0) {
+        p->lengths[hit > length ? hit : length]++;
+    }
+    if (p->symbols < PROBE_PERIOD) return;
+
+    unsigned long long chars = 0;
+    for (int len = 1; len <= p->bound; len++) {
+        chars += (unsigned long long)len * p->lengths[len];
+    }
+    // longest length that keeps at least 1/16 of the sampled characters above it
+    unsigned long long above = 0;
+    int longest = p->bound;
+    while (longest > 1 && 16*(above + (unsigned long long)longest * p->lengths[longest]) < chars) {
+        above += (unsigned long long)longest * p->lengths[longest];
+        longest--;
+    }
+    int limit = PROBE_MIN;
+    while (limit < longest) limit *= 2;
+    p->limit = limit < p->bound ? limit : p->bound;
+    DEBUG_PRINT("probe limit: %d\n", p->limit);
+
+    p->symbols = 0;
+    memset(p->lengths, 0, sizeof(p->lengths));
+}
@@ -0,0 +1,28 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#define PROBE_PERIOD 4096   // symbols coded between two adjustments of the limit
+#define PROBE_SAMPLE 8      // every PROBE_SAMPLE-th symbol is probed up to the bound
+#define PROBE_MIN 4         // the limit is never lower, unless the bound is
+
+// adaptive limit on the number of characters probed at each position by the string engine
+// the tree and the counting trie are only searched up to the limit, except at samples, which are searched
+// up to the bound, the lengths found there do not depend on the limit and set it for the next period:
+// to the lowest power of 2 that leaves less than 1/16 of the sampled characters in longer strings
+// the first period is probed up to the bound
+// the limit depends only on the input, so output is the same for every run, and the decoder does
+// not need it, since every new string is written with its length
+typedef struct Probe_limit {
+
+    int limit;      // number of characters probed at positions that are not sampled
+    int bound;      // upper bound for the limit, the probe depth of the level and LEN
+    int symbols;    // symbols coded in this period
+    unsigned int lengths[256];  // number of samples of each length in this period
+
+} Probe_limit;
+
+void init_probe_limit(Probe_limit* p, int bound);
+int probe_depth(Probe_limit* p);
+void probe_limit_update(Probe_limit* p, int hit, int length);
+
+#endif // PROBE_H
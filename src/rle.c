@@ -0,0 +1,87 @@
+#include <string.h>
+#include "rle.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+// add the run leaf to an empty tree
+void add_run_leaf(Tree* tree) {
+    update_tree(tree, tree->nyt, "", 0);
+    tree->run_leaf = tree_last_added(tree);
+}
+
+// number of characters at the start of data that are equal to the first one, at most n
+// compared 32 at a time with AVX2, 16 at a time with SSE2, else 8 at a time in a word
+size_t run_length(const char* data, size_t n) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i c32 = _mm256_set1_epi8(data[0]);
+    for (; i + 32 <= n; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)&data[i]);
+        unsigned int differ = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, c32));
+        if (differ) return i + __builtin_ctz(differ);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i c16 = _mm_set1_epi8(data[0]);
+    for (; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)&data[i]);
+        unsigned int differ = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, c16)) & 0xffff;
+        if (differ) return i + __builtin_ctz(differ);
+    }
+#endif
+
+    unsigned long long c8 = (unsigned char)data[0] * 0x0101010101010101ULL;
+    for (; i + 8 <= n; i += 8) {
+        unsigned long long block;
+        memcpy(&block, &data[i], 8);
+        if (block != c8) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return i + (__builtin_clzll(block ^ c8) >> 3);
+#else
+            return i + (__builtin_ctzll(block ^ c8) >> 3);
+#endif
+        }
+    }
+    while (i < n && data[i] == data[0]) i++;
+    return i;
+}
+
+// output a run of n (RLE_MIN_RUN to RLE_MAX_RUN) characters c and update tree, returns the number of bits written
+int write_run(huffman_io* io, Tree* tree, unsigned char c, size_t n) {
+    int bits = write_code(io, tree->run_leaf);
+    update_tree(tree, tree->run_leaf, NULL, 0);
+    write_byte(io, c);
+    bits += 8;
+
+    size_t value = n - RLE_MIN_RUN;
+    while (value >= 0x80) {
+        write_byte(io, (uint8)(value | 0x80));
+        value >>= 7;
+        bits += 8;
+    }
+    write_byte(io, (uint8)value);
+    return bits + 8;
+}
+
+// read a run after the code of the run leaf and write it to out
+// returns the length of the run, 0 if it is longer than RLE_MAX_RUN
+size_t read_run(huffman_io* io, huffman_io* out) {
+    uint8 c = read_byte(io);
+
+    size_t value = 0;
+    for (int shift = 0; shift < 21; shift += 7) {
+        uint8 byte = read_byte(io);
+        value |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            size_t n = value + RLE_MIN_RUN;
+            if (n > RLE_MAX_RUN) return 0;
+            write_repeated(out, c, n);
+            return n;
+        }
+    }
+    return 0;
+}
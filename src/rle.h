@@ -0,0 +1,22 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <stddef.h>
+#include "huffman.h"
+#include "huffman_io.h"
+
+#define RLE_MIN_RUN 16          // shorter runs are coded as strings
+#define RLE_MAX_RUN (1 << 16)   // longer runs are split
+
+// runs of one character are coded with a leaf for an empty string, the run leaf, which is added
+// to the tree before anything else, so its code adapts to how often runs occur
+// a run is the code of the run leaf, the character (8 bits) and the length of the run minus RLE_MIN_RUN
+// in 7 bits per byte, least significant first, as a varint
+// the decoder expands a run with memset instead of one leaf per fragment of the run
+
+void add_run_leaf(Tree* tree);
+size_t run_length(const char* data, size_t n);
+int write_run(huffman_io* io, Tree* tree, unsigned char c, size_t n);
+size_t read_run(huffman_io* io, huffman_io* out);
+
+#endif // RLE_H
@@ -0,0 +1,147 @@
+#include <stdint.h>
+#include <string.h>
+#include "snapshot.h"
+#include "huffman_util.h"
+#include "trie.h"
+#include "arena.h"
+#include "decode_table.h"
+
+// a pointer stored in a snapshot, and a pointer of a restored snapshot at base
+#define TO_OFFSET(offset) ((void*)(uintptr_t)((offset) + 1))
+#define RELOCATE(ptr, base) ((ptr) = (ptr) ? (void*)((base) + ((uintptr_t)(ptr) - 1)) : NULL)
+
+// internal functions
+void* node_offset(Node* node);
+
+
+// copy tree and the trie of its strings into a new snapshot, tree is not changed
+Snapshot* take_snapshot(Tree* tree) {
+
+    Snapshot* snapshot = (Snapshot*)safe_calloc(1, sizeof(Snapshot));
+    snapshot->nodes = tree->nodes;
+    snapshot->trie_nodes = tree->trie && tree->trie->root ? tree->trie->nodes : 0;
+    snapshot->run_leaf = tree->run_leaf ? (int)tree->run_leaf->order : -1;
+
+    size_t strings = 0;
+    for (Node* node = tree->root; node; node = node->next_ord) {
+        if (node->string) strings += node->strlength + 1;
+    }
+    size_t nodes_size = snapshot->nodes * sizeof(Node);
+    size_t trie_size = snapshot->trie_nodes * sizeof(Trie_node);
+    snapshot->size = nodes_size + trie_size + strings;
+    snapshot->data = (char*)safe_malloc(snapshot->size);
+
+    // the order of a node is its index
+    Node* nodes = (Node*)snapshot->data;
+    size_t string_pos = nodes_size + trie_size;
+    for (Node* node = tree->root; node; node = node->next_ord) {
+        Node* copy = &nodes[node->order];
+        *copy = *node;
+        copy->parent = node_offset(node->parent);
+        copy->left = node_offset(node->left);
+        copy->right = node_offset(node->right);
+        copy->prev_ord = node_offset(node->prev_ord);
+        copy->next_ord = node_offset(node->next_ord);
+        if (node->string) {
+            memcpy(&snapshot->data[string_pos], node->string, node->strlength + 1);
+            copy->string = TO_OFFSET(string_pos);
+            string_pos += node->strlength + 1;
+        }
+    }
+
+    // trie nodes in preorder, with an explicit stack as sibling chains can be too long for recursion
+    // each node is stacked with the pointer of its parent that must be set to its offset
+    if (snapshot->trie_nodes) {
+        Trie_node* trie_nodes = (Trie_node*)&snapshot->data[nodes_size];
+        Trie_node** stack = (Trie_node**)safe_malloc(snapshot->trie_nodes * sizeof(Trie_node*));
+        Trie_node*** slots = (Trie_node***)safe_malloc(snapshot->trie_nodes * sizeof(Trie_node**));
+        int top = 0, next = 0;
+        Trie_node* root_slot;
+        stack[top] = tree->trie->root;
+        slots[top++] = &root_slot;
+        while (top > 0) {
+            top--;
+            Trie_node* node = stack[top];
+            Trie_node* copy = &trie_nodes[next];
+            *slots[top] = TO_OFFSET(nodes_size + next * sizeof(Trie_node));
+            next++;
+
+            *copy = *node;
+            copy->data.huff_node = node_offset(node->data.huff_node);
+            copy->left = copy->right = copy->next = NULL;
+            // pushed in reverse, so the smaller characters come first
+            if (node->right) {
+                stack[top] = node->right;
+                slots[top++] = &copy->right;
+            }
+            if (node->next) {
+                stack[top] = node->next;
+                slots[top++] = &copy->next;
+            }
+            if (node->left) {
+                stack[top] = node->left;
+                slots[top++] = &copy->left;
+            }
+        }
+        free(stack);
+        free(slots);
+    }
+    return snapshot;
+}
+
+// offset of node in a snapshot
+void* node_offset(Node* node) {
+    return node ? TO_OFFSET(node->order * sizeof(Node)) : NULL;
+}
+
+// replace tree and the trie of its strings with a copy of the snapshot, tree must have a trie
+// the bound on the depth and the decode table of tree are kept
+void restore_snapshot(Tree* tree, Snapshot* snapshot) {
+
+    reset_arena(tree->arena);
+    clear_trie(tree->trie);
+    memset(tree->byte_leaf, 0, sizeof(tree->byte_leaf));
+
+    char* base = (char*)arena_alloc(tree->arena, snapshot->size);
+    memcpy(base, snapshot->data, snapshot->size);
+
+    Node* nodes = (Node*)base;
+    for (int i = 0; i < snapshot->nodes; i++) {
+        Node* node = &nodes[i];
+        RELOCATE(node->parent, base);
+        RELOCATE(node->left, base);
+        RELOCATE(node->right, base);
+        RELOCATE(node->prev_ord, base);
+        RELOCATE(node->next_ord, base);
+        RELOCATE(node->string, base);
+        if (node->strlength == 1) {
+            tree->byte_leaf[(unsigned char)node->string[0]] = node;
+        }
+    }
+
+    Trie_node* trie_nodes = (Trie_node*)&base[snapshot->nodes * sizeof(Node)];
+    for (int i = 0; i < snapshot->trie_nodes; i++) {
+        Trie_node* node = &trie_nodes[i];
+        RELOCATE(node->data.huff_node, base);
+        RELOCATE(node->left, base);
+        RELOCATE(node->right, base);
+        RELOCATE(node->next, base);
+    }
+    if (snapshot->trie_nodes) {
+        tree->trie->root = trie_nodes;
+        tree->trie->nodes = snapshot->trie_nodes;
+    }
+
+    tree->root = &nodes[0];
+    tree->nyt = &nodes[snapshot->nodes - 1];
+    tree->run_leaf = snapshot->run_leaf >= 0 ? &nodes[snapshot->run_leaf] : NULL;
+    tree->nodes = snapshot->nodes;
+    decode_table_touch(tree, tree->root);
+}
+
+void free_snapshot(Snapshot* snapshot) {
+    if (snapshot) {
+        free(snapshot->data);
+        free(snapshot);
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include "huffman.h"
+
+// copy of a tree with the trie of its strings in one block of memory: the tree nodes in order of the order list,
+// then the trie nodes in preorder, then the strings of the leaves
+// pointers in the block are offsets from its start plus 1 (0 for NULL), so the block can be copied anywhere
+// a tree is restored with one copy of the block into its arena and one pass over the nodes that adds the
+// address of the copy to each pointer, instead of adding all strings again
+// the root has order 0 and nyt the last order, so only the run leaf is stored separately
+typedef struct Snapshot {
+
+    char* data;
+    size_t size;
+
+    int nodes;          // number of tree nodes
+    int trie_nodes;     // number of nodes in the trie of the tree
+    int run_leaf;       // order of the run leaf, -1 if the tree has none
+
+} Snapshot;
+
+Snapshot* take_snapshot(Tree* tree);
+void restore_snapshot(Tree* tree, Snapshot* snapshot);
+void free_snapshot(Snapshot* snapshot);
+
+#endif // SNAPSHOT_H
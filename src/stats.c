@@ -0,0 +1,175 @@
+#include <string.h>
+#include "stats.h"
+#include "huffman_util.h"
+#include "trie.h"
+#include "arena.h"
+
+// internal functions
+void write_json(FILE* file, Tree_stats* stats);
+void write_csv(FILE* file, Tree_stats* stats);
+void write_escaped(FILE* file, const char* str, int length, int csv);
+
+// collect statistics of tree without recursion, count_trie may be NULL
+void collect_tree_stats(Tree* tree, Trie* count_trie, unsigned long long bytes, Tree_stats* stats) {
+
+    memset(stats, 0, sizeof(Tree_stats));
+    stats->bytes = bytes;
+    stats->nodes = tree->nodes;
+    stats->tree_bytes = tree_size(tree);
+    stats->tree_arena_bytes = tree->arena->allocated;
+    stats->tree_trie_nodes = tree->trie->nodes;
+    stats->trie_arena_bytes = tree->trie->arena->allocated;
+    if (count_trie) {
+        stats->count_trie_nodes = count_trie->nodes;
+        stats->trie_arena_bytes += count_trie->arena->allocated;
+    }
+
+    // depth first search with an explicit stack, the stack never holds more than depth+1 nodes
+    Node** stack = (Node**)safe_malloc(sizeof(Node*) * (tree->nodes + 1));
+    int* depths = (int*)safe_malloc(sizeof(int) * (tree->nodes + 1));
+    int top = 0;
+    stack[top] = tree->root;
+    depths[top++] = 0;
+
+    unsigned long long weighted_depth = 0;
+    unsigned long long total_weight = 0;
+    while (top > 0) {
+        Node* node = stack[--top];
+        int depth = depths[top];
+
+        if (node->left) {
+            stack[top] = node->right;
+            depths[top++] = depth + 1;
+            stack[top] = node->left;
+            depths[top++] = depth + 1;
+            continue;
+        }
+
+        if (depth > stats->max_depth) stats->max_depth = depth;
+        if (node == tree->nyt) {
+            stats->nyt_depth = depth;
+            continue;
+        }
+
+        stats->leaves++;
+        stats->depth_histogram[depth < STATS_MAX_DEPTH ? depth : STATS_MAX_DEPTH]++;
+        stats->length_histogram[node->strlength]++;
+        int bucket = 0;
+        for (unsigned int w = node->weight; w; w >>= 1) bucket++;
+        stats->weight_histogram[bucket]++;
+        weighted_depth += (unsigned long long)node->weight * depth;
+        total_weight += node->weight;
+    }
+    stats->avg_depth = total_weight ? (double)weighted_depth / total_weight : 0;
+    free(stack);
+    free(depths);
+
+    // order list is sorted by weight, so the first leaves in it are the heaviest
+    for (Node* node = tree->root; node && stats->num_top_leaves < STATS_TOP_LEAVES; node = node->next_ord) {
+        if (!node->left && node != tree->nyt) {
+            stats->top_depths[stats->num_top_leaves] = node_depth(node);
+            stats->top_leaves[stats->num_top_leaves++] = node;
+        }
+    }
+}
+
+// write statistics as one line of json, or as csv rows of the form bytes,section,key,value
+void write_tree_stats(FILE* file, Tree_stats* stats, int csv) {
+    if (csv) {
+        write_csv(file, stats);
+    } else {
+        write_json(file, stats);
+    }
+    fflush(file);
+}
+
+// collect statistics and write them to the statistics file in the options
+void export_tree_stats(huffman_options* opts, Tree* tree, Trie* count_trie, unsigned long long bytes) {
+    Tree_stats stats;
+    collect_tree_stats(tree, count_trie, bytes, &stats);
+    write_tree_stats(opts->stats_file, &stats, opts->stats_csv);
+}
+
+void write_json(FILE* file, Tree_stats* stats) {
+
+    fprintf(file, "{\"bytes\":%llu,\"nodes\":%i,\"leaves\":%i,\"nyt_depth\":%i,\"max_depth\":%i,\"avg_depth\":%.3f,",
+        stats->bytes, stats->nodes, stats->leaves, stats->nyt_depth, stats->max_depth, stats->avg_depth);
+    fprintf(file, "\"memory\":{\"tree_bytes\":%lu,\"tree_arena_bytes\":%lu,\"tree_trie_nodes\":%i,\"count_trie_nodes\":%i,\"trie_arena_bytes\":%lu},",
+        stats->tree_bytes, stats->tree_arena_bytes, stats->tree_trie_nodes, stats->count_trie_nodes, stats->trie_arena_bytes);
+
+    fprintf(file, "\"depth_histogram\":[");
+    for (int i = 0; i <= STATS_MAX_DEPTH; i++) {
+        fprintf(file, i ? ",%lu" : "%lu", stats->depth_histogram[i]);
+    }
+
+    // only lengths that occur, as an object
+    fprintf(file, "],\"length_histogram\":{");
+    int first = 1;
+    for (int i = 0; i < 256; i++) {
+        if (!stats->length_histogram[i]) continue;
+        fprintf(file, first ? "\"%i\":%lu" : ",\"%i\":%lu", i, stats->length_histogram[i]);
+        first = 0;
+    }
+
+    fprintf(file, "},\"weight_histogram\":[");
+    for (int i = 0; i < STATS_WEIGHT_BUCKETS; i++) {
+        fprintf(file, i ? ",%lu" : "%lu", stats->weight_histogram[i]);
+    }
+
+    fprintf(file, "],\"top_leaves\":[");
+    for (int i = 0; i < stats->num_top_leaves; i++) {
+        Node* leaf = stats->top_leaves[i];
+        fprintf(file, i ? ",{\"string\":\"" : "{\"string\":\"");
+        write_escaped(file, leaf->string, leaf->strlength, 0);
+        fprintf(file, "\",\"weight\":%u,\"depth\":%i}", leaf->weight, stats->top_depths[i]);
+    }
+    fprintf(file, "]}\n");
+}
+
+void write_csv(FILE* file, Tree_stats* stats) {
+
+    unsigned long long b = stats->bytes;
+    fprintf(file, "%llu,tree,nodes,%i\n", b, stats->nodes);
+    fprintf(file, "%llu,tree,leaves,%i\n", b, stats->leaves);
+    fprintf(file, "%llu,tree,nyt_depth,%i\n", b, stats->nyt_depth);
+    fprintf(file, "%llu,tree,max_depth,%i\n", b, stats->max_depth);
+    fprintf(file, "%llu,tree,avg_depth,%.3f\n", b, stats->avg_depth);
+    fprintf(file, "%llu,memory,tree_bytes,%lu\n", b, stats->tree_bytes);
+    fprintf(file, "%llu,memory,tree_arena_bytes,%lu\n", b, stats->tree_arena_bytes);
+    fprintf(file, "%llu,memory,tree_trie_nodes,%i\n", b, stats->tree_trie_nodes);
+    fprintf(file, "%llu,memory,count_trie_nodes,%i\n", b, stats->count_trie_nodes);
+    fprintf(file, "%llu,memory,trie_arena_bytes,%lu\n", b, stats->trie_arena_bytes);
+
+    for (int i = 0; i <= STATS_MAX_DEPTH; i++) {
+        if (stats->depth_histogram[i]) fprintf(file, "%llu,depth,%i,%lu\n", b, i, stats->depth_histogram[i]);
+    }
+    for (int i = 0; i < 256; i++) {
+        if (stats->length_histogram[i]) fprintf(file, "%llu,length,%i,%lu\n", b, i, stats->length_histogram[i]);
+    }
+    for (int i = 0; i < STATS_WEIGHT_BUCKETS; i++) {
+        if (stats->weight_histogram[i]) fprintf(file, "%llu,weight_log2,%i,%lu\n", b, i, stats->weight_histogram[i]);
+    }
+    for (int i = 0; i < stats->num_top_leaves; i++) {
+        Node* leaf = stats->top_leaves[i];
+        fprintf(file, "%llu,top_leaf,\"", b);
+        write_escaped(file, leaf->string, leaf->strlength, 1);
+        fprintf(file, "\",%u\n", leaf->weight);
+    }
+}
+
+// write string with quotes, backslashes and non printable characters escaped
+// in csv, quotes are doubled and other characters are written as \xHH
+void write_escaped(FILE* file, const char* str, int length, int csv) {
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if (c == '"') {
+            fputs(csv ? "\"\"" : "\\\"", file);
+        } else if (c == '\\') {
+            fputs("\\\\", file);
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf(file, csv ? "\\x%02x" : "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+}
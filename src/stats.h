@@ -0,0 +1,43 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "huffman.h"
+
+#define STATS_MAX_DEPTH 64      // leaves deeper than this are counted in the last bucket
+#define STATS_WEIGHT_BUCKETS 33 // bucket i holds leaves with a weight of 2^(i-1) .. 2^i - 1
+#define STATS_TOP_LEAVES 10     // number of heaviest leaves listed
+
+// snapshot of the shape of a huffman tree, all sizes are fixed so a snapshot is cheap for any tree
+typedef struct Tree_stats {
+
+    unsigned long long bytes;   // number of input bytes coded when the snapshot was taken
+
+    int nodes;
+    int leaves;
+    int nyt_depth;
+    int max_depth;
+    double avg_depth;   // average leaf depth weighted by leaf weight, i.e. bits per symbol
+
+    // memory in bytes
+    unsigned long tree_bytes;       // nodes as counted by tree_size
+    unsigned long tree_arena_bytes; // memory allocated for nodes and strings
+    int tree_trie_nodes;            // trie of strings in the tree
+    int count_trie_nodes;           // counting trie of the encoder, 0 when decoding
+    unsigned long trie_arena_bytes; // memory allocated for both tries
+
+    unsigned long depth_histogram[STATS_MAX_DEPTH+1];   // number of leaves at each depth
+    unsigned long length_histogram[256];                // number of leaves for each string length
+    unsigned long weight_histogram[STATS_WEIGHT_BUCKETS];
+
+    Node* top_leaves[STATS_TOP_LEAVES];
+    int top_depths[STATS_TOP_LEAVES];
+    int num_top_leaves;
+
+} Tree_stats;
+
+void collect_tree_stats(Tree* tree, Trie* count_trie, unsigned long long bytes, Tree_stats* stats);
+void write_tree_stats(FILE* file, Tree_stats* stats, int csv);
+void export_tree_stats(huffman_options* opts, Tree* tree, Trie* count_trie, unsigned long long bytes);
+
+#endif // STATS_H
@@ -1,10 +1,17 @@
 #include "trie.h"
 #include "huffman_util.h"
+#include "arena.h"
 #include <string.h>
 
+// internal functions
+Trie_node* find_or_add_sibling(Trie* trie, Trie_node* node, char c);
+Trie_node* next_or_add(Trie* trie, Trie_node* node);
+Trie_node* root_or_add(Trie* trie, char c);
+
 // initialize ternary trie
 Trie* init_trie() {
     Trie* trie = (Trie*)safe_calloc(1, sizeof(Trie));
+    trie->arena = init_arena();
     return trie;
 }
 
@@ -15,64 +22,78 @@ typedef enum ADD_TYPE {
     INT
 } ADD_TYPE;
 
-// add a node to the trie, either with a given huffman tree node, or an integer
-// in case of the huffman node, add new node if string not yet in trie, else overwrite the huffman node
-// in case of integer, add new node with count=1 if not yet string not yey in trie, else increment the counter
-// returns the counter of the node, if type is HUFF_NODE, returns 0
-int trie_add_internal(Trie* trie, char* str, int length, ADD_TYPE type, Node* huff_node) {
+// find node with character c among node and its smaller and greater siblings
+// if it does not exist, create it
+Trie_node* find_or_add_sibling(Trie* trie, Trie_node* node, char c) {
+
+    while (c != node->character) {
+
+        if (c > node->character) {
+            // character is greater than current one, go right
+
+            if (!node->right) {
+                // node with character does not exist, create new node
+                node->right = (Trie_node*)arena_alloc(trie->arena, sizeof(Trie_node));    // arena memory is set to 0
+                node->right->character = c;
+                trie->nodes++;
+            }
+            // go to next node
+            node = node->right;
 
-    // handle special case where root does not yet exist
+        } else {
+            // character is lesser than current one, go left
+
+            if (!node->left) {
+                // node with character does not exist, create new node
+                node->left = (Trie_node*)arena_alloc(trie->arena, sizeof(Trie_node));    // arena memory is set to 0
+                node->left->character = c;
+                trie->nodes++;
+            }
+            // go to next node
+            node = node->left;
+        }
+    }
+    return node;
+}
+
+// go to the node of the next character, if it does not exist, create it
+Trie_node* next_or_add(Trie* trie, Trie_node* node) {
+    if (!node->next) {
+        // next node gets the current character, find_or_add_sibling moves to the right one
+        node->next = (Trie_node*)arena_alloc(trie->arena, sizeof(Trie_node));     // arena memory is set to 0
+        node->next->character = node->character;
+        trie->nodes++;
+    }
+    return node->next;
+}
+
+// get root of trie, if trie is empty, create root with given character
+Trie_node* root_or_add(Trie* trie, char c) {
     if (!trie->root) {
         // root does not exist, create it
-        trie->root = (Trie_node*)safe_calloc(1, sizeof(Trie_node));
-        trie->root->character = str[0];
+        trie->root = (Trie_node*)arena_alloc(trie->arena, sizeof(Trie_node));
+        trie->root->character = c;
         trie->nodes++;
     }
+    return trie->root;
+}
 
-    Trie_node* node = trie->root;
+// add a node to the trie, either with a given huffman tree node, or an integer
+// in case of the huffman node, add new node if string not yet in trie, else overwrite the huffman node
+// in case of integer, add new node with count=1 if not yet string not yey in trie, else increment the counter
+// returns the counter of the node, if type is HUFF_NODE, returns 0
+int trie_add_internal(Trie* trie, const char* str, int length, ADD_TYPE type, Node* huff_node) {
 
-    for (int i = 0; i < length; i++) {
+    Trie_node* node = root_or_add(trie, str[0]);
 
-        char c = str[i];
+    for (int i = 0; i < length; i++) {
 
         // find node of current character, if it does not exist, create it
-        while (c != node->character) {
-
-            if (c > node->character) {
-                // character is greater than current one, go right
-
-                if (!node->right) {
-                    // node with character does not exist, create new node
-                    node->right = (Trie_node*)safe_calloc(1, sizeof(Trie_node));    // calloc sets data to 0
-                    node->right->character = c;
-                    trie->nodes++;
-                }
-                // go to next node
-                node = node->right;
-
-            } else {
-                // character is lesser than current one, go left
-
-                if (!node->left) {
-                    // node with character does not exist, create new node
-                    node->left = (Trie_node*)safe_calloc(1, sizeof(Trie_node));    // calloc sets data to 0
-                    node->left->character = c;
-                    trie->nodes++;
-                }
-                // go to next node
-                node = node->left;
-            }
-        }
+        node = find_or_add_sibling(trie, node, str[i]);
 
         if (i < length-1) {
             // string not yet completed, go to next character
-            if (!node->next) { 
-                // if next node does not exist, create new node
-                node->next = (Trie_node*)safe_calloc(1, sizeof(Trie_node));     // calloc sets data to 0
-                node->next->character = c;
-                trie->nodes++;
-            }
-            node = node->next;
+            node = next_or_add(trie, node);
         }
     }
     // string completed, check type
@@ -89,20 +110,83 @@ int trie_add_internal(Trie* trie, char* str, int length, ADD_TYPE type, Node* hu
     return -1;  // should never reach here
 }
 
+// increment the counters of all prefixes of str with at least min_length characters, in one pass
+// prefixes not yet in the trie are added, counts[len] is set to the counter of the prefix of length len
+// this is the same as calling trie_increment_string_count for each prefix, without walking the trie again
+void trie_increment_prefix_counts(Trie* trie, const char* str, int length, int min_length, int* counts) {
+
+    Trie_node* node = root_or_add(trie, str[0]);
+
+    for (int i = 0; i < length; i++) {
+
+        node = find_or_add_sibling(trie, node, str[i]);
+        if (i+1 >= min_length) {
+            counts[i+1] = ++node->data.count;
+        }
+
+        if (i < length-1) {
+            node = next_or_add(trie, node);
+        }
+    }
+}
+
+// find all prefixes of str that have a huffman node
+// huff_nodes[len] is set to the huffman node of the prefix of length len, NULL if it has none
+void trie_prefix_nodes(Trie* trie, const char* str, int length, Node** huff_nodes) {
+
+    Trie_node* node = trie->root;
+
+    for (int i = 0; i < length; i++) {
+
+        char c = str[i];
+        while (node && c != node->character) {
+            node = (c > node->character) ? node->right : node->left;
+        }
+        huff_nodes[i+1] = node ? node->data.huff_node : NULL;
+        if (node) {
+            node = node->next;
+        }
+    }
+}
+
+// find the longest prefix of str that has a huffman node
+// returns its length and sets huff_node, returns 0 if no prefix has a huffman node
+int trie_longest_prefix(Trie* trie, const char* str, int length, Node** huff_node) {
+
+    int longest = 0;
+    Trie_node* node = trie->root;
+
+    for (int i = 0; i < length && node; i++) {
+
+        char c = str[i];
+        while (node && c != node->character) {
+            node = (c > node->character) ? node->right : node->left;
+        }
+        if (!node) break;
+
+        if (node->data.huff_node) {
+            longest = i+1;
+            *huff_node = node->data.huff_node;
+        }
+        node = node->next;
+    }
+    return longest;
+}
+
 // find a string in given trie and increment its counter
 // if the string does not yet exist in trie, add it
 // return the counter
-int trie_increment_string_count(Trie* trie, char* str, int length) {
+int trie_increment_string_count(Trie* trie, const char* str, int length) {
     return trie_add_internal(trie, str, length, INT, NULL);
 }
 
 // add a string to the trie with given huffman node
-void trie_add_string_node(Trie* trie, char* str, int length, Node* huff_node) {
+void trie_add_string_node(Trie* trie, const char* str, int length, Node* huff_node) {
     trie_add_internal(trie, str, length, HUFF_NODE, huff_node);
 }
 
 // find trie node with given string
-Trie_node* trie_find_string(Trie* trie, char* str, int length) {
+Trie_node* trie_find_string(Trie* trie, const char* str, int length) {
 
     Trie_node* node = trie->root;
 
@@ -129,28 +213,18 @@ Trie_node* trie_find_string(Trie* trie, char* str, int length) {
     return node;
 }
 
-// recursively free memory allocated by nodes
-void free_trie_node_rec(Trie_node* node) {
-    if (node) {
-        free_trie_node_rec(node->left);
-        free_trie_node_rec(node->right);
-        free_trie_node_rec(node->next);
-        free(node);
-    }
-}
-
 // free memory allocated by ternary trie
 void free_trie(Trie* trie) {
     if (trie) {
-        free_trie_node_rec(trie->root);
+        free_arena(trie->arena);
         free(trie);
     }
 }
 
-// remove all nodes in trie but not the trie itself
+// remove all nodes in trie but not the trie itself, node memory is kept for reuse
 void clear_trie(Trie* trie) {
     if (trie) {
-        free_trie_node_rec(trie->root);
+        reset_arena(trie->arena);
         trie->nodes = 0;
         trie->root = NULL;
     }
@@ -2,6 +2,7 @@
 #define TRIE_H
 
 typedef struct Node Node;   // forward declaration
+typedef struct Arena Arena; // forward declaration
 
 // node in ternary trie
 typedef struct Trie_node {
@@ -30,17 +31,25 @@ typedef struct Trie_node {
 typedef struct Trie {
     Trie_node* root;
 
+    // memory for trie nodes
+    Arena* arena;
+
     int nodes;  // number of nodes in the trie
 
-} Trie;     // 16 bytes total
+} Trie;     // 24 bytes total
 
 
 Trie* init_trie();
 
-void trie_add_string_node(Trie* trie, char* str, int length, Node* huff_node);
-int trie_increment_string_count(Trie* trie, char* str, int length);
+void trie_add_string_node(Trie* trie, const char* str, int length, Node* huff_node);
+int trie_increment_string_count(Trie* trie, const char* str, int length);
+
+Trie_node* trie_find_string(Trie* trie, const char* str, int length);
 
-Trie_node* trie_find_string(Trie* trie, char* str, int length);
+// all prefixes of a string at once
+void trie_increment_prefix_counts(Trie* trie, const char* str, int length, int min_length, int* counts);
+int trie_longest_prefix(Trie* trie, const char* str, int length, Node** huff_node);
+void trie_prefix_nodes(Trie* trie, const char* str, int length, Node** huff_nodes);
 
 void free_trie(Trie* trie);
 void clear_trie(Trie* trie);
@@ -0,0 +1,134 @@
+#include <string.h>
+#include <time.h>
+#include "tune.h"
+#include "huffman_io.h"
+#include "huffman_util.h"
+
+// values of LEN tried on the sample
+const int TUNE_LENGTHS[] = {1, 4, 8, 16, 32, 64, 128, 255};
+#define TUNE_NUM_LENGTHS (int)(sizeof(TUNE_LENGTHS) / sizeof(TUNE_LENGTHS[0]))
+
+#define TUNE_MEM_STEPS 2    // number of MEM indices tried above the smallest that fits
+
+#define TUNE_SPEED_SLACK 0.25 // objective speed: output may be this much larger than the smallest
+
+// result of compressing the sample with one setting
+typedef struct Trial {
+    unsigned long long size;    // output bytes
+    double seconds;
+} Trial;
+
+// internal functions
+Trial run_trial(huffman_options* trial, Tree* tree, Trie* trie, const char* sample, size_t sample_len);
+int best_trial(Trial* trials, int n, int objective);
+int choose_max_mem(int max_chars, unsigned long long nodes);
+
+
+// returns objective with the given name, or -1 if there is none
+int parse_objective(const char* name) {
+    if (strcmp(name, "balanced") == 0) return TUNE_BALANCED;
+    if (strcmp(name, "speed") == 0) return TUNE_SPEED;
+    if (strcmp(name, "ratio") == 0) return TUNE_RATIO;
+    return -1;
+}
+
+// set LEN and MEM in opts for the input in lookahead
+// the first TUNE_SAMPLE_SIZE bytes are compressed in memory with each LEN, the output is only counted
+// then MEM is tried from the smallest that fits the tree of the best LEN, scaled from the sample to
+// the whole input, up to TUNE_MEM_STEPS larger ones, these also differ in how often the counting trie is cleared
+// tree and trie are used for the trial runs, nothing of the input is encoded
+void tune_options(huffman_options* opts, Tree* tree, Trie* trie, Lookahead* la) {
+
+    size_t sample_len;
+    const char* sample = lookahead_peek_n(la, TUNE_SAMPLE_SIZE, &sample_len);
+
+    // trial runs are single threaded, LEN is chosen without a memory limit
+    huffman_options trial = *opts;
+    trial.max_mem = 9;
+    trial.analysis = 0;
+    trial.stats_file = NULL;
+
+    Trial trials[TUNE_NUM_LENGTHS];
+    int nodes_used[TUNE_NUM_LENGTHS];
+    for (int i = 0; i < TUNE_NUM_LENGTHS; i++) {
+        trial.max_chars = TUNE_LENGTHS[i];
+        trials[i] = run_trial(&trial, tree, trie, sample, sample_len);
+        nodes_used[i] = tree->nodes;
+    }
+    int best = best_trial(trials, TUNE_NUM_LENGTHS, opts->objective);
+    opts->max_chars = TUNE_LENGTHS[best];
+    trial.max_chars = opts->max_chars;
+
+    // size of input is known if it is mapped or shorter than the sample
+    unsigned long long total = la->eof ? la->len - la->pos : (unsigned long long)sample_len * TUNE_UNKNOWN_SCALE;
+    unsigned long long nodes = sample_len ? nodes_used[best] * total / sample_len : 0;
+    int min_mem = choose_max_mem(opts->max_chars, nodes);
+
+    int num_mems = 0;
+    for (int mem = min_mem; mem <= min_mem + TUNE_MEM_STEPS && mem <= 9; mem++) {
+        trial.max_mem = mem;
+        trials[num_mems++] = run_trial(&trial, tree, trie, sample, sample_len);
+    }
+    opts->max_mem = min_mem + best_trial(trials, num_mems, opts->objective);
+    DEBUG_PRINT("tune: chose LEN %i, MEM %i\n", opts->max_chars, opts->max_mem);
+}
+
+// compress sample with the trial options, returns output size and time
+Trial run_trial(huffman_options* trial, Tree* tree, Trie* trie, const char* sample, size_t sample_len) {
+
+    Lookahead sample_la;
+    init_lookahead_memory(&sample_la, sample, sample_len, trial->max_chars + trial->lazy);
+    huffman_io io = init_io(NULL, WRITE);  // no file, bytes are only counted
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    encode_input(tree, trie, trial, &sample_la, &io, NULL);
+    close_io(&io);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    Trial result;
+    result.size = io.bytes_out;
+    result.seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    DEBUG_PRINT("tune: LEN %i, MEM %i, %llu bytes, %.3f s\n", trial->max_chars, trial->max_mem, result.size, result.seconds);
+    return result;
+}
+
+// returns index of the best of n trials for the objective, on a tie the first one
+// speed: the fastest trial whose output is at most TUNE_SPEED_SLACK larger than the smallest output
+// ratio: the smallest output
+// balanced: the smallest product of output size and time
+int best_trial(Trial* trials, int n, int objective) {
+
+    unsigned long long smallest = trials[0].size;
+    for (int i = 1; i < n; i++) {
+        if (trials[i].size < smallest) smallest = trials[i].size;
+    }
+
+    int best = -1;
+    double best_score = 0;
+    for (int i = 0; i < n; i++) {
+        double score;
+        if (objective == TUNE_SPEED) {
+            if (trials[i].size > smallest * (1 + TUNE_SPEED_SLACK)) continue;
+            score = trials[i].seconds;
+        } else if (objective == TUNE_RATIO) {
+            score = (double)trials[i].size;
+        } else {
+            score = trials[i].size * trials[i].seconds;
+        }
+        if (best < 0 || score < best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+// smallest MEM index whose tree can hold <nodes> nodes of <max_chars> characters, 9 if none can
+int choose_max_mem(int max_chars, unsigned long long nodes) {
+    for (int mem = 0; mem < 9; mem++) {
+        int max_nodes = calc_max_tree_nodes(mem, max_chars);   // negative if MEM is too small for LEN
+        if (max_nodes > 0 && (unsigned long long)max_nodes >= nodes) return mem;
+    }
+    return 9;
+}
@@ -0,0 +1,20 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include "huffman.h"
+#include "lookahead.h"
+
+#define TUNE_SAMPLE_SIZE (1 << 20)  // bytes at the start of the input compressed with each LEN
+#define TUNE_UNKNOWN_SCALE 16       // assumed input size in samples if the size of the input is not known
+
+// what -c auto chooses LEN and MEM for
+typedef enum tune_objective {
+    TUNE_BALANCED,  // smallest product of output size and time
+    TUNE_SPEED,     // shortest time, among settings with an output close to the smallest
+    TUNE_RATIO      // smallest output
+} tune_objective;
+
+int parse_objective(const char* name);
+void tune_options(huffman_options* opts, Tree* tree, Trie* trie, Lookahead* la);
+
+#endif // TUNE_H
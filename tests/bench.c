@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include "../src/huffman.h"
+#include "../src/huffman_io.h"
+#include "../src/trie.h"
+#include "../src/huffman_util.h"
+
+// microbenchmarks of the primitives of the coder: tree updates, trie operations, paths and bit io
+// every benchmark runs <reps> times on the same pregenerated input, the time per operation is
+// reported as mean, standard deviation and minimum over the runs
+
+#define DEFAULT_REPS 7
+#define TREE_OPS 1000000
+#define TRIE_KEYS 200000
+#define PATH_OPS 10000000
+#define IO_BYTES (8 << 20)
+
+// a benchmark runs <ops> operations on its input once
+typedef struct Benchmark {
+    const char* name;
+    void (*setup)(struct Benchmark* b);
+    void (*run)(struct Benchmark* b);
+    long ops;
+    int param1;     // e.g. key length
+    int param2;     // e.g. alphabet size
+    void* data;     // pregenerated input
+} Benchmark;
+
+// results are added to this, so the compiler cannot remove the work
+volatile unsigned long sink;
+
+// internal functions
+unsigned long next_random();
+double now_ns();
+void measure(Benchmark* b, int reps);
+char* random_keys(long n, int length, int alphabet);
+
+
+// xorshift, a fixed seed makes every run use the same input
+unsigned long random_state = 88172645463325252UL;
+unsigned long next_random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// n keys of <length> characters from the first <alphabet> byte values, one after the other
+char* random_keys(long n, int length, int alphabet) {
+    char* keys = (char*)safe_malloc(n * length);
+    for (long i = 0; i < n * length; i++) {
+        keys[i] = (char)(next_random() % alphabet);
+    }
+    return keys;
+}
+
+
+// update_tree: input is a sequence of 4 character symbols
+
+// feed all symbols to a new tree
+void run_update_tree(Benchmark* b) {
+    Tree* tree = init_tree();
+    const char* symbols = (const char*)b->data;
+    for (long i = 0; i < b->ops; i++) {
+        const char* str = &symbols[4*i];
+        Node* node = tree_find_node(tree, str, 4);
+        update_tree(tree, node ? node : tree->nyt, str, 4);
+    }
+    sink += tree->nodes;
+    free_tree(tree);
+}
+
+// store symbol as 4 characters
+void put_symbol(char* symbols, long i, unsigned int symbol) {
+    memcpy(&symbols[4*i], &symbol, 4);
+}
+
+// uniform over 4096 symbols
+void setup_uniform(Benchmark* b) {
+    char* symbols = (char*)safe_malloc(4 * b->ops);
+    for (long i = 0; i < b->ops; i++) {
+        put_symbol(symbols, i, next_random() % 4096);
+    }
+    b->data = symbols;
+}
+
+// zipf distribution over 4096 symbols, a few symbols make up most of the input
+void setup_skewed(Benchmark* b) {
+    int n = 4096;
+    double cdf[n];
+    double sum = 0;
+    for (int k = 0; k < n; k++) {
+        sum += 1.0 / (k + 1);
+        cdf[k] = sum;
+    }
+    char* symbols = (char*)safe_malloc(4 * b->ops);
+    for (long i = 0; i < b->ops; i++) {
+        double r = (double)(next_random() % 1000000000) / 1e9 * sum;
+        int lo = 0, hi = n - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (cdf[mid] < r) lo = mid + 1; else hi = mid;
+        }
+        put_symbol(symbols, i, lo);
+    }
+    b->data = symbols;
+}
+
+// symbol k occurs fib(k) times, in random order, this makes the deepest tree for the number of symbols
+// every update of a rare symbol walks a long path and swaps many nodes
+void setup_adversarial(Benchmark* b) {
+    long count = 0;
+    long fib[64];
+    int n = 0;
+    for (long f1 = 1, f2 = 1; count + f1 <= b->ops && n < 64; n++) {
+        fib[n] = f1;
+        count += f1;
+        long f = f1 + f2;
+        f1 = f2;
+        f2 = f;
+    }
+    b->ops = count;
+    char* symbols = (char*)safe_malloc(4 * count);
+    long i = 0;
+    for (int k = 0; k < n; k++) {
+        for (long j = 0; j < fib[k]; j++) {
+            put_symbol(symbols, i++, k);
+        }
+    }
+    // shuffle
+    for (i = count - 1; i > 0; i--) {
+        long j = next_random() % (i + 1);
+        char tmp[4];
+        memcpy(tmp, &symbols[4*i], 4);
+        memcpy(&symbols[4*i], &symbols[4*j], 4);
+        memcpy(&symbols[4*j], tmp, 4);
+    }
+    b->data = symbols;
+}
+
+
+// trie: param1 is the key length, param2 the alphabet size
+
+void setup_trie_keys(Benchmark* b) {
+    b->data = random_keys(b->ops, b->param1, b->param2);
+}
+
+// add all keys to a new trie
+void run_trie_add(Benchmark* b) {
+    Trie* trie = init_trie();
+    const char* keys = (const char*)b->data;
+    for (long i = 0; i < b->ops; i++) {
+        trie_add_string_node(trie, &keys[i * b->param1], b->param1, (Node*)trie);
+    }
+    sink += trie->nodes;
+    free_trie(trie);
+}
+
+// find keys that are all in the trie, the trie is built outside of the measurement
+Trie* find_trie = NULL;
+void setup_trie_find(Benchmark* b) {
+    setup_trie_keys(b);
+    free_trie(find_trie);
+    find_trie = init_trie();
+    const char* keys = (const char*)b->data;
+    for (long i = 0; i < b->ops; i++) {
+        trie_add_string_node(find_trie, &keys[i * b->param1], b->param1, (Node*)find_trie);
+    }
+}
+
+void run_trie_find(Benchmark* b) {
+    const char* keys = (const char*)b->data;
+    for (long i = 0; i < b->ops; i++) {
+        sink += (unsigned long)trie_find_string(find_trie, &keys[i * b->param1], b->param1);
+    }
+}
+
+// count keys drawn from a set of a quarter of the number of operations, so most keys are counted before
+void setup_trie_count(Benchmark* b) {
+    char* pool = random_keys(b->ops / 4, b->param1, b->param2);
+    char* keys = (char*)safe_malloc(b->ops * b->param1);
+    for (long i = 0; i < b->ops; i++) {
+        memcpy(&keys[i * b->param1], &pool[(next_random() % (b->ops / 4)) * b->param1], b->param1);
+    }
+    free(pool);
+    b->data = keys;
+}
+
+void run_trie_count(Benchmark* b) {
+    Trie* trie = init_trie();
+    const char* keys = (const char*)b->data;
+    for (long i = 0; i < b->ops; i++) {
+        sink += trie_increment_string_count(trie, &keys[i * b->param1], b->param1);
+    }
+    free_trie(trie);
+}
+
+
+// write_code: param1 is the depth of the leaf, the tree is a chain of nodes, bits are only counted
+// after the first call the code of the leaf is cached if it fits, the uncached run clears it before every call
+
+void setup_path(Benchmark* b) {
+    Node* nodes = (Node*)safe_calloc(b->param1 + 1, sizeof(Node));
+    for (int i = 1; i <= b->param1; i++) {
+        nodes[i].parent = &nodes[i-1];
+        if (i % 2) {
+            nodes[i-1].right = &nodes[i];
+        } else {
+            nodes[i-1].left = &nodes[i];
+        }
+    }
+    b->data = nodes;
+}
+
+void run_path(Benchmark* b) {
+    Node* nodes = (Node*)b->data;
+    Node* leaf = &nodes[b->param1];
+    huffman_io io = init_io(NULL, WRITE);
+    for (long i = 0; i < b->ops; i++) {
+        sink += write_code(&io, leaf);
+    }
+    close_io(&io);
+}
+
+void run_path_uncached(Benchmark* b) {
+    Node* nodes = (Node*)b->data;
+    Node* leaf = &nodes[b->param1];
+    huffman_io io = init_io(NULL, WRITE);
+    for (long i = 0; i < b->ops; i++) {
+        leaf->code = 0;
+        sink += write_code(&io, leaf);
+    }
+    close_io(&io);
+}
+
+
+// bit io: writes only count the bytes, reads come from a file in memory
+
+void setup_random_bytes(Benchmark* b) {
+    b->data = random_keys(b->ops / 8 + 1, 1, 256);
+}
+
+void run_write_bit(Benchmark* b) {
+    huffman_io io = init_io(NULL, WRITE);
+    const uint8* bytes = (const uint8*)b->data;
+    for (long i = 0; i < b->ops; i++) {
+        write_bit(&io, (bytes[i >> 3] >> (i & 7)) & 1);
+    }
+    flush(&io);
+    close_io(&io);
+    sink += io.bytes_out;
+}
+
+void run_write_byte(Benchmark* b) {
+    huffman_io io = init_io(NULL, WRITE);
+    const uint8* bytes = (const uint8*)b->data;
+    write_bit(&io, 1);  // not byte aligned, as in the coder
+    for (long i = 0; i < b->ops; i++) {
+        write_byte(&io, bytes[i & (IO_BYTES/8 - 1)]);
+    }
+    flush(&io);
+    close_io(&io);
+    sink += io.bytes_out;
+}
+
+void run_read_bit(Benchmark* b) {
+    FILE* file = fmemopen(b->data, b->ops / 8, "rb");
+    huffman_io io = init_io(file, READ);
+    unsigned long ones = 0;
+    for (long i = 0; i < b->ops; i++) {
+        ones += read_bit(&io);
+    }
+    close_io(&io);
+    fclose(file);
+    sink += ones;
+}
+
+
+// run benchmark reps times after one warm up run, and print the time per operation
+void measure(Benchmark* b, int reps) {
+
+    if (b->setup) b->setup(b);
+    b->run(b);
+
+    double mean = 0, sq = 0, min = 0;
+    for (int r = 0; r < reps; r++) {
+        double start = now_ns();
+        b->run(b);
+        double ns = (now_ns() - start) / b->ops;
+
+        // running mean and variance
+        double delta = ns - mean;
+        mean += delta / (r + 1);
+        sq += delta * (ns - mean);
+        if (r == 0 || ns < min) min = ns;
+    }
+    double stddev = reps > 1 ? sqrt(sq / (reps - 1)) : 0;
+
+    char name[64];
+    if (b->param2) {
+        snprintf(name, sizeof(name), "%s len %i abc %i", b->name, b->param1, b->param2);
+    } else if (b->param1) {
+        snprintf(name, sizeof(name), "%s depth %i", b->name, b->param1);
+    } else {
+        snprintf(name, sizeof(name), "%s", b->name);
+    }
+    printf("%-44s %10ld %10.2f %9.2f %10.2f\n", name, b->ops, mean, stddev, min);
+    fflush(stdout);
+
+    free(b->data);
+    b->data = NULL;
+}
+
+int main(int argc, char** argv) {
+
+    int reps = DEFAULT_REPS;
+    const char* filter = NULL;  // only run benchmarks whose name contains this
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:f:")) != -1) {
+        switch (opt) {
+            case 'r':
+                reps = (int)strtol(optarg, NULL, 10);
+                if (reps < 1) {
+                    fprintf(stderr, "Error: number of runs must be at least 1\n");
+                    exit(1);
+                }
+                break;
+
+            case 'f':
+                filter = optarg;
+                break;
+
+            default:
+                fprintf(stderr, "Usage: bench [-r REPS] [-f FILTER]\n");
+                exit(1);
+        }
+    }
+
+    Benchmark benchmarks[] = {
+        {"update_tree uniform", setup_uniform, run_update_tree, TREE_OPS, 0, 0, NULL},
+        {"update_tree skewed", setup_skewed, run_update_tree, TREE_OPS, 0, 0, NULL},
+        {"update_tree adversarial", setup_adversarial, run_update_tree, TREE_OPS, 0, 0, NULL},
+
+        {"trie_add_string_node", setup_trie_keys, run_trie_add, TRIE_KEYS, 4, 4, NULL},
+        {"trie_add_string_node", setup_trie_keys, run_trie_add, TRIE_KEYS, 4, 256, NULL},
+        {"trie_add_string_node", setup_trie_keys, run_trie_add, TRIE_KEYS, 32, 4, NULL},
+        {"trie_add_string_node", setup_trie_keys, run_trie_add, TRIE_KEYS, 32, 26, NULL},
+        {"trie_add_string_node", setup_trie_keys, run_trie_add, TRIE_KEYS, 32, 256, NULL},
+        {"trie_find_string", setup_trie_find, run_trie_find, TRIE_KEYS, 4, 4, NULL},
+        {"trie_find_string", setup_trie_find, run_trie_find, TRIE_KEYS, 4, 256, NULL},
+        {"trie_find_string", setup_trie_find, run_trie_find, TRIE_KEYS, 32, 4, NULL},
+        {"trie_find_string", setup_trie_find, run_trie_find, TRIE_KEYS, 32, 26, NULL},
+        {"trie_find_string", setup_trie_find, run_trie_find, TRIE_KEYS, 32, 256, NULL},
+        {"trie_increment_string_count", setup_trie_count, run_trie_count, TRIE_KEYS, 4, 4, NULL},
+        {"trie_increment_string_count", setup_trie_count, run_trie_count, TRIE_KEYS, 4, 256, NULL},
+        {"trie_increment_string_count", setup_trie_count, run_trie_count, TRIE_KEYS, 32, 4, NULL},
+        {"trie_increment_string_count", setup_trie_count, run_trie_count, TRIE_KEYS, 32, 26, NULL},
+        {"trie_increment_string_count", setup_trie_count, run_trie_count, TRIE_KEYS, 32, 256, NULL},
+
+        {"write_code", setup_path, run_path, PATH_OPS, 4, 0, NULL},
+        {"write_code", setup_path, run_path, PATH_OPS, 16, 0, NULL},
+        {"write_code", setup_path, run_path, PATH_OPS, 32, 0, NULL},
+        {"write_code", setup_path, run_path, PATH_OPS, 62, 0, NULL},
+        {"write_code", setup_path, run_path, PATH_OPS / 4, 200, 0, NULL},
+        {"write_code uncached", setup_path, run_path_uncached, PATH_OPS, 4, 0, NULL},
+        {"write_code uncached", setup_path, run_path_uncached, PATH_OPS, 16, 0, NULL},
+
+        {"write_bit", setup_random_bytes, run_write_bit, 8L * IO_BYTES, 0, 0, NULL},
+        {"write_byte", setup_random_bytes, run_write_byte, IO_BYTES, 0, 0, NULL},
+        {"read_bit", setup_random_bytes, run_read_bit, 8L * IO_BYTES, 0, 0, NULL},
+    };
+    int n = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+    printf("%-44s %10s %10s %9s %10s\n", "benchmark (ns/op)", "ops", "mean", "stddev", "min");
+    for (int i = 0; i < n; i++) {
+        if (filter && !strstr(benchmarks[i].name, filter)) continue;
+        measure(&benchmarks[i], reps);
+    }
+    free_trie(find_trie);
+    return 0;
+}
@@ -4,14 +4,17 @@
 #include <stdlib.h>
 #include "test_tree.h"
 #include "test_trie.h"
+#include "test_stream.h"
+#include "../src/lz77.h"
 
 int test_tree(int argc, char** argv);
 int test_trie(int argc, char** argv);
+int test_stream(int argc, char** argv);
 
 int main(int argc, char** argv) {
     
     if (argc < 2) {
-        fprintf(stderr, "Error: first argument must be either tree or trie\n");
+        fprintf(stderr, "Error: first argument must be tree, trie or stream\n");
         exit(1);
     }
 
@@ -19,8 +22,10 @@ int main(int argc, char** argv) {
         return test_tree(argc, argv);
     } else if (strcmp(argv[1], "trie") == 0) {
         return test_trie(argc, argv);
+    } else if (strcmp(argv[1], "stream") == 0) {
+        return test_stream(argc, argv);
     } else {
-        fprintf(stderr, "Error: first argument must be either tree or trie\n");
+        fprintf(stderr, "Error: first argument must be tree, trie or stream\n");
         exit(1);
     }
 }
@@ -30,10 +35,12 @@ int test_tree(int argc, char** argv) {
     int vflag = 0;
     char* test_string = DEFAULT_STRING;
     int chars_per_node = 1;
+    int max_depth = 0;      // bound on the depth of the tree, the text is then repeated until the tree is rescaled
+    int deep = 0;           // depth of a tree made without input, to check codes longer than a word
 
     int opt;
 
-    while ((opt = getopt(argc, argv, "vi:c:")) != -1) {
+    while ((opt = getopt(argc, argv, "vi:c:L:D:")) != -1) {
         switch (opt) {
             case 'v':
                 vflag = 1;
@@ -51,6 +58,22 @@ int test_tree(int argc, char** argv) {
                 }
                 break;
             
+            case 'L':
+                max_depth = (int)strtol(optarg, NULL, 10);
+                if (max_depth < MIN_MAX_DEPTH || max_depth > MAX_MAX_DEPTH) {
+                    fprintf(stderr, "Error: L argument must be between %i and %i\n", MIN_MAX_DEPTH, MAX_MAX_DEPTH);
+                    exit(1);
+                }
+                break;
+            
+            case 'D':
+                deep = (int)strtol(optarg, NULL, 10);
+                if (deep < 1) {
+                    fprintf(stderr, "Error: D argument must be at least 1\n");
+                    exit(1);
+                }
+                break;
+            
             case '?':
                 fprintf(stderr, "Error: unknown option or missing argument\n");
                 exit(1);
@@ -60,7 +83,20 @@ int test_tree(int argc, char** argv) {
 
     // create huffman tree to test with
     Tree* tree = init_tree();
-    make_test_tree(tree, test_string, 1);
+    if (deep) {
+        // only the codes of this tree are valid
+        make_deep_tree(tree, deep);
+        if (vflag) printf("testing codes of a tree with depth %i\n\n", deep);
+        assert(tree_check_codes(tree, vflag));
+        printf("all tests succeeded!\n");
+        free_tree(tree);
+        return 0;
+    }
+    set_max_depth(tree, max_depth);
+    unsigned int rounds = max_depth ? 2 * depth_weight(max_depth) / strlen(test_string) + 1 : 1;
+    for (unsigned int i = 0; i < rounds; i++) {
+        make_test_tree(tree, test_string, 1);
+    }
 
     if (vflag) printf("testing with text: %s\n", test_string);
     if (vflag) printf("testing with %i characters per node\n\n", chars_per_node);
@@ -72,6 +108,10 @@ int test_tree(int argc, char** argv) {
     assert(tree_check_num_nodes(tree, vflag));
     assert(tree_check_brothers(tree, vflag));
     assert(tree_check_size(tree, vflag));
+    assert(tree_check_codes(tree, vflag));
+    assert(tree_check_decode(tree, vflag));
+    if (max_depth) assert(tree_check_depth(tree, max_depth, vflag));
+    assert(tree_check_snapshot(tree, test_string, vflag));
 
     printf("all tests succeeded!\n");
 
@@ -117,4 +157,85 @@ int test_trie(int argc, char** argv) {
 
     free_trie(trie);
     return 0;
-}
\ No newline at end of file
+}
+
+int test_stream(int argc, char** argv) {
+
+    int vflag = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+            case 'v':
+                vflag = 1;
+                break;
+            
+            case '?':
+                fprintf(stderr, "Error: unknown option or missing argument\n");
+                exit(1);
+                break;
+        }
+    }
+
+    size_t len;
+    char* data = make_test_input(&len);
+    if (vflag) printf("testing with %zu bytes of input\n\n", len);
+
+    // each format is compressed and decompressed, also with empty input and 1 byte
+    huffman_options opts = init_options();
+    opts.max_chars = 8;
+    opts.max_mem = 5;
+    assert(stream_check(&opts, "strings", data, len, vflag));
+
+    opts = init_options();
+    opts.max_mem = 4;
+    assert(stream_check(&opts, "bytes", data, len, vflag));
+
+    opts = init_options();
+    opts.max_chars = 16;
+    opts.max_mem = 5;
+    opts.lanes = 3;
+    assert(stream_check(&opts, "lanes", data, len, vflag));
+
+    opts = init_options();
+    opts.max_chars = 8;
+    opts.max_mem = 5;
+    opts.contexts = 16;
+    assert(stream_check(&opts, "contexts", data, len, vflag));
+
+    opts = init_options();
+    opts.max_chars = 8;
+    opts.max_mem = 5;
+    assert(stream_check_append(&opts, "checkpoint and append", data, len, vflag));
+
+    opts = init_options();
+    opts.max_chars = 8;
+    opts.max_mem = 5;
+    opts.dedup = 1;
+    assert(stream_check(&opts, "dedup", data, len, vflag));
+
+    opts = init_options();
+    opts.max_chars = 8;
+    opts.max_mem = 5;
+    opts.window = 12;
+    assert(stream_check(&opts, "window", data, len, vflag));
+
+    opts.window = LZ77_MAX_WINDOW;
+    opts.lazy = 1;
+    assert(stream_check(&opts, "lazy matches in the largest window", data, len, vflag));
+
+    opts = init_options();
+    opts.max_chars = 8;
+    opts.max_mem = 5;
+    opts.rle = 1;
+    assert(stream_check(&opts, "runs", data, len, vflag));
+
+    opts.max_chars = 1;
+    assert(stream_check(&opts, "runs of bytes", data, len, vflag));
+    assert(stream_check_corrupt_run(vflag));
+
+    printf("all tests succeeded!\n");
+
+    free(data);
+    return 0;
+}
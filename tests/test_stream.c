@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_stream.h"
+#include "test_tree.h"
+#include "../src/huffman_util.h"
+#include "../src/checkpoint.h"
+#include "../src/header.h"
+#include "../src/rle.h"
+
+// internal functions
+FILE* open_test_input(const char* data, size_t len, int mapped);
+int same_output(FILE* file, const char* data, size_t len);
+
+
+// input with text, a long run of one character, random bytes and a copy of them further on,
+// so strings, runs, matches of the LZ77 engine and repeated chunks all occur in it
+char* make_test_input(size_t* len) {
+    size_t text_len = strlen(DEFAULT_STRING);
+    size_t random_len = 3 << 14;
+    size_t size = 4 * text_len + 5000 + 2 * random_len + 3000;
+    char* data = (char*)safe_malloc(size);
+
+    size_t pos = 0;
+    for (int i = 0; i < 4; i++) {
+        memcpy(&data[pos], DEFAULT_STRING, text_len);
+        pos += text_len;
+    }
+    memset(&data[pos], 'o', 5000);
+    pos += 5000;
+
+    // random bytes from a fixed seed
+    size_t random_pos = pos;
+    unsigned int state = 12345;
+    for (size_t i = 0; i < random_len; i++) {
+        state = state * 1103515245 + 12345;
+        data[pos++] = (char)(state >> 16);
+    }
+    memcpy(&data[pos], &data[random_pos], random_len);
+    pos += random_len;
+
+    // short repeated pattern
+    for (int i = 0; i < 3000; i++) {
+        data[pos++] = "abc"[i % 3];
+    }
+    *len = pos;
+    return data;
+}
+
+// compress data with opts, decompress it again and compare with data
+// the input is a regular file that is mapped if mapped is set, else a stream in memory
+int stream_round_trip(huffman_options* opts, const char* data, size_t len, int mapped, int verbose) {
+    FILE* input = open_test_input(data, len, mapped);
+    FILE* compressed = tmpfile();
+    FILE* output = tmpfile();
+    if (!input || !compressed || !output) {
+        fprintf(stderr, "Error: could not create temporary files\n");
+        exit(1);
+    }
+
+    compress(opts, input, compressed);
+    fflush(compressed);
+    long compressed_len = ftell(compressed);
+    rewind(compressed);
+
+    Tree* tree = init_tree();
+    huffman_options dopts = init_options();
+    dopts.dict = opts->dict;
+    int res = decompress_tree(tree, &dopts, compressed, output) == 0 && same_output(output, data, len);
+    free_tree(tree);
+
+    if (verbose) printf("%zu bytes, %s input, %ld bytes compressed: %s\n", len, mapped ? "mapped" : "streamed", compressed_len, res ? "ok" : "FAILED");
+    fclose(input);
+    fclose(compressed);
+    fclose(output);
+    return res;
+}
+
+// round trip of empty input, of 1 byte and of all data, each mapped and streamed
+int stream_check(huffman_options* opts, const char* name, const char* data, size_t len, int verbose) {
+    if (verbose) printf("checking %s ...\n", name);
+
+    int res = 1;
+    for (int mapped = 0; mapped <= 1; mapped++) {
+        res = res && stream_round_trip(opts, data, 0, mapped, verbose);
+        res = res && stream_round_trip(opts, data, 1, mapped, verbose);
+        res = res && stream_round_trip(opts, data, len, mapped, verbose);
+    }
+
+    if (verbose) printf("-----------\n\n");
+    return res;
+}
+
+// compress the first bytes of data with a checkpoint, append the next ones from the checkpoint,
+// then decompress the whole stream and compare it with both parts
+int stream_append_round_trip(huffman_options* opts, const char* data, size_t first, size_t second, int verbose) {
+
+    // the checkpoint is saved next to the output, as with -k
+    char output_name[] = "/tmp/persen_test_XXXXXX";
+    int fd = mkstemp(output_name);
+    if (fd < 0) {
+        fprintf(stderr, "Error: could not create temporary files\n");
+        exit(1);
+    }
+    close(fd);
+    char checkpoint_name[sizeof(output_name) + sizeof(CHECKPOINT_EXTENSION)];
+    strcpy(checkpoint_name, output_name);
+    strcat(checkpoint_name, CHECKPOINT_EXTENSION);
+
+    huffman_options aopts = *opts;
+    aopts.checkpoint = checkpoint_name;
+    for (int append = 0; append <= 1; append++) {
+        aopts.append = append;
+        FILE* input = open_test_input(append ? &data[first] : data, append ? second : first, !append);
+        FILE* output = fopen(output_name, append ? "r+b" : "wb");
+        if (!input || !output) {
+            fprintf(stderr, "Error: could not create temporary files\n");
+            exit(1);
+        }
+        compress(&aopts, input, output);
+        fclose(input);
+        fclose(output);
+    }
+
+    FILE* compressed = fopen(output_name, "rb");
+    FILE* output = tmpfile();
+    Tree* tree = init_tree();
+    huffman_options dopts = init_options();
+    int res = compressed && output && decompress_tree(tree, &dopts, compressed, output) == 0 && same_output(output, data, first + second);
+    free_tree(tree);
+
+    if (verbose) printf("%zu bytes, then %zu bytes appended: %s\n", first, second, res ? "ok" : "FAILED");
+    if (compressed) fclose(compressed);
+    if (output) fclose(output);
+    remove(output_name);
+    remove(checkpoint_name);
+    return res;
+}
+
+// appends to empty and 1 byte streams, of empty input and 1 byte, and of the rest of data
+int stream_check_append(huffman_options* opts, const char* name, const char* data, size_t len, int verbose) {
+    if (verbose) printf("checking %s ...\n", name);
+
+    int res = stream_append_round_trip(opts, data, 0, 0, verbose);
+    res = res && stream_append_round_trip(opts, data, 0, 1, verbose);
+    res = res && stream_append_round_trip(opts, data, 1, 0, verbose);
+    res = res && stream_append_round_trip(opts, data, 1, len - 1, verbose);
+    res = res && stream_append_round_trip(opts, data, len / 2, len - len / 2, verbose);
+
+    if (verbose) printf("-----------\n\n");
+    return res;
+}
+
+// decode a stream of a valid run followed by a second run, which is valid if corrupt is 0,
+// longer than RLE_MAX_RUN if corrupt is 1, or has a length that does not end if corrupt is 2
+// returns 1 if the decoder accepts the valid stream and rejects the corrupt ones
+int stream_decode_run(int max_chars, int corrupt, int verbose) {
+    FILE* compressed = tmpfile();
+    FILE* output = tmpfile();
+    if (!compressed || !output) {
+        fprintf(stderr, "Error: could not create temporary files\n");
+        exit(1);
+    }
+
+    // written as the encoder does with -r, the stream has no size, so only the run can fail it
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.max_chars = max_chars;
+    header.max_mem = 5;
+    header.engine = max_chars == 1 ? ENGINE_BYTES : ENGINE_STRINGS;
+    header.flags = HEADER_HAS_RUNS;
+    header.lanes = 1;
+
+    Tree* tree = init_tree();
+    huffman_io io = init_io(compressed, WRITE);
+    write_header(&io, &header);
+    add_run_leaf(tree);
+    write_run(&io, tree, 'a', RLE_MIN_RUN + 4);
+    if (corrupt == 2) {
+        write_code(&io, tree->run_leaf);
+        update_tree(tree, tree->run_leaf, NULL, 0);
+        write_byte(&io, 'b');
+        for (int i = 0; i < 4; i++) write_byte(&io, 0xff);
+    } else {
+        write_run(&io, tree, 'b', corrupt ? RLE_MAX_RUN + 1 : RLE_MAX_RUN);
+    }
+    write_code(&io, tree->nyt);
+    write_byte(&io, 0);
+    close_io(&io);
+    fflush(compressed);
+    rewind(compressed);
+
+    huffman_options dopts = init_options();
+    int failed = decompress_tree(tree, &dopts, compressed, output) != 0;
+    int res = corrupt ? failed : !failed;
+    free_tree(tree);
+
+    if (verbose) printf("LEN %i, %s run: %s\n", max_chars, corrupt == 0 ? "valid" : corrupt == 1 ? "too long" : "unterminated", res ? "ok" : "FAILED");
+    fclose(compressed);
+    fclose(output);
+    return res;
+}
+
+// invalid runs make decoding fail with strings and with single characters
+int stream_check_corrupt_run(int verbose) {
+    if (verbose) printf("checking corrupt runs ...\n");
+
+    int res = 1;
+    for (int corrupt = 0; corrupt <= 2; corrupt++) {
+        res = res && stream_decode_run(8, corrupt, verbose);
+        res = res && stream_decode_run(1, corrupt, verbose);
+    }
+
+    if (verbose) printf("-----------\n\n");
+    return res;
+}
+
+// file with data at position 0
+FILE* open_test_input(const char* data, size_t len, int mapped) {
+    if (!mapped) {
+        // fmemopen fails on a buffer of size 0, an empty file is read the same way
+        return len ? fmemopen((void*)data, len, "rb") : tmpfile();
+    }
+    FILE* file = tmpfile();
+    if (file && (fwrite(data, 1, len, file) != len || fflush(file) || fseek(file, 0, SEEK_SET))) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+// check that file holds exactly data
+int same_output(FILE* file, const char* data, size_t len) {
+    fflush(file);
+    rewind(file);
+    char* buf = (char*)safe_malloc(len + 1);
+    size_t n = fread(buf, 1, len + 1, file);
+    int res = n == len && memcmp(buf, data, len) == 0;
+    free(buf);
+    return res;
+}
@@ -0,0 +1,15 @@
+#ifndef TEST_STREAM_H
+#define TEST_STREAM_H
+
+#include <stddef.h>
+#include "../src/huffman.h"
+
+char* make_test_input(size_t* len);
+int stream_round_trip(huffman_options* opts, const char* data, size_t len, int mapped, int verbose);
+int stream_check(huffman_options* opts, const char* name, const char* data, size_t len, int verbose);
+int stream_append_round_trip(huffman_options* opts, const char* data, size_t first, size_t second, int verbose);
+int stream_check_append(huffman_options* opts, const char* name, const char* data, size_t len, int verbose);
+int stream_decode_run(int max_chars, int corrupt, int verbose);
+int stream_check_corrupt_run(int verbose);
+
+#endif // TEST_STREAM_H
@@ -1,5 +1,10 @@
+#include <stdlib.h>
 #include <string.h>
 #include "test_tree.h"
+#include "../src/huffman_io.h"
+#include "../src/arena.h"
+#include "../src/decode_table.h"
+#include "../src/snapshot.h"
 
 // make huffman tree with given text, with given number of characters per node
 void make_test_tree(Tree* tree, const char* text, int chars_per_node) {
@@ -8,15 +13,24 @@ void make_test_tree(Tree* tree, const char* text, int chars_per_node) {
     char str[chars_per_node+1];
     str[chars_per_node] = '\0';
 
+    // codes are only counted, but written as the encoder does, so later updates must clear the cached ones
+    huffman_io io = init_io(NULL, WRITE);
+
     // update tree for each characer in string
-    for (int i=0; i<strlen(text); i+=chars_per_node) {
-        strncpy(str, &text[i], chars_per_node);
+    // the last string is padded with '\0' if the text runs out
+    size_t len = strlen(text);
+    for (int i=0; i<len; i+=chars_per_node) {
+        size_t n = len - i < chars_per_node ? len - i : chars_per_node;
+        memcpy(str, &text[i], n);
+        memset(&str[n], 0, chars_per_node - n);
         Node* node = tree_find_node(tree, str, chars_per_node);
         if (!node) {
             node = tree->nyt;
         }
+        write_code(&io, node);
         update_tree(tree, node, str, chars_per_node);
     }
+    close_io(&io);
 }
 
 // recursively check if nodes have either 0 or 2 children
@@ -144,4 +158,147 @@ int tree_check_size(Tree* tree, int verbose) {
         printf("-----------\n\n");
     }
     return size == tree_size(tree);
-}
\ No newline at end of file
+}
+
+// replace tree by a tree with one leaf at each depth and two at the deepest, as deep as no input can make it
+// only the shape is valid, not the weights or the order list
+void make_deep_tree(Tree* tree, int depth) {
+    reset_tree(tree);
+    Node* node = tree->root;
+    for (int d = 0; d < depth; d++) {
+        node->left = (Node*)arena_alloc(tree->arena, sizeof(Node));
+        node->right = (Node*)arena_alloc(tree->arena, sizeof(Node));
+        node->left->parent = node;
+        node->right->parent = node;
+        // alternate sides, so codes are not all zeros
+        node = d % 3 ? node->left : node->right;
+    }
+    tree->nyt = node;
+    tree->nodes = 2*depth + 1;
+}
+
+int max_depth_rec(Node* node) {
+    if (!node->left) return 0;
+    int left = max_depth_rec(node->left);
+    int right = max_depth_rec(node->right);
+    return 1 + (left > right ? left : right);
+}
+
+// check if no leaf is deeper than max_depth
+int tree_check_depth(Tree* tree, int max_depth, int verbose) {
+    int depth = max_depth_rec(tree->root);
+    if (verbose) printf("checking depth ...\n");
+    if (verbose) printf("depth %i, bound %i\n", depth, max_depth);
+    if (verbose) printf("-----------\n\n");
+    return depth <= max_depth;
+}
+
+// write code of node and follow the bits from the root, this must end in node after as many bits as its depth
+int check_code(Node* node, int verbose) {
+    huffman_io io = init_memory_io();
+    int bits = write_code(&io, node);
+    flush(&io);
+
+    Node* curr = node;
+    while (curr->parent) curr = curr->parent;
+    for (int i = 0; i < bits && curr->left; i++) {
+        int bit = (io.buf[i / 8] >> (7 - i % 8)) & 1;
+        curr = bit ? curr->right : curr->left;
+    }
+    close_io(&io);
+    if (verbose) printf("node %i, %i bits\n", node->order, bits);
+    return curr == node && bits == node_depth(node);
+}
+
+int check_codes_rec(Node* node, int verbose) {
+    if (!node->left) return check_code(node, verbose);
+    return check_codes_rec(node->left, verbose) && check_codes_rec(node->right, verbose);
+}
+
+// check if the code written for each leaf leads from the root to that leaf
+int tree_check_codes(Tree* tree, int verbose) {
+    if (verbose) printf("checking codes ...\n");
+    int res = check_codes_rec(tree->root, verbose);
+    if (verbose) printf("-----------\n\n");
+    return res;
+}
+
+// write the codes of all leaves several times and decode them with a decode table
+// the first DECODE_REBUILD codes are decoded bit by bit, then the table is built and used for the others
+int tree_check_decode(Tree* tree, int verbose) {
+    if (verbose) printf("checking decode table ...\n");
+
+    huffman_io io = init_memory_io();
+    int rounds = DECODE_REBUILD + 1;
+    for (int r = 0; r < rounds; r++) {
+        for (Node* node = tree->root; node; node = node->next_ord) {
+            if (!node->left) write_code(&io, node);
+        }
+    }
+    flush(&io);
+
+    FILE* file = fmemopen(io.buf, io.buf_pos, "r");
+    huffman_io in = init_io(file, READ);
+    tree->decode = init_decode_table();
+
+    int res = 1;
+    for (int r = 0; r < rounds && res; r++) {
+        for (Node* node = tree->root; node && res; node = node->next_ord) {
+            if (node->left) continue;
+            Node* decoded = decode_prefix(tree, &in);
+            while (decoded->left) {
+                decoded = read_bit(&in) ? decoded->right : decoded->left;
+            }
+            if (verbose) printf("node %i, decoded node %i\n", node->order, decoded->order);
+            res = decoded == node;
+        }
+    }
+    // the table must have been used
+    res = res && !tree->decode->dirty;
+
+    free(tree->decode);
+    tree->decode = NULL;
+    close_io(&in);
+    fclose(file);
+    close_io(&io);
+    if (verbose) printf("-----------\n\n");
+    return res;
+}
+
+// nodes of both trees have the same weights, strings and children, in the same order
+// and every string of a leaf is found in both tries
+int same_trees(Tree* a, Tree* b, int verbose) {
+    if (a->nodes != b->nodes) return 0;
+    Node* y = b->root;
+    for (Node* x = a->root; x; x = x->next_ord, y = y->next_ord) {
+        if (verbose) printf("node %i, weight %u and %u\n", x->order, x->weight, y->weight);
+        if (!y || x->order != y->order || x->weight != y->weight || x->strlength != y->strlength) return 0;
+        if (x->string && (!y->string || memcmp(x->string, y->string, x->strlength))) return 0;
+        if ((x->parent ? x->parent->order : -1) != (y->parent ? y->parent->order : -1)) return 0;
+        if (x->left && (x->left->order != y->left->order || x->right->order != y->right->order)) return 0;
+        if (x->string && x->strlength > 0 && tree_find_node(b, x->string, x->strlength) != y) return 0;
+    }
+    return !y && (a->nyt->order == b->nyt->order);
+}
+
+// copy tree with a snapshot into another tree, the copy must be the same tree and stay the same
+// when strings of several lengths are added to both, so its trie is used after the copy too
+int tree_check_snapshot(Tree* tree, const char* text, int verbose) {
+    if (verbose) printf("checking snapshot ...\n");
+
+    make_test_tree(tree, text, 4);
+    Snapshot* snapshot = take_snapshot(tree);
+    Tree* copy = init_tree();
+    make_test_tree(copy, "the copy replaces all of this", 2);
+    restore_snapshot(copy, snapshot);
+    free_snapshot(snapshot);
+
+    int res = same_trees(tree, copy, verbose);
+    make_test_tree(tree, text, 3);
+    make_test_tree(copy, text, 3);
+    res = res && same_trees(tree, copy, verbose);
+
+    free_tree(copy);
+    if (verbose) printf("-----------\n\n");
+    return res;
+}
@@ -31,11 +31,16 @@ oooooh ooooooh ooooooh oooooh\n\
 oooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooooh\n"
 
 void make_test_tree(Tree* tree, const char* str, int chars_per_node);
+void make_deep_tree(Tree* tree, int depth);
 int tree_is_binary(Tree* tree, int verbose);
 int tree_check_weights(Tree* tree, int verbose);
 int tree_check_order(Tree* tree, int verbose);
 int tree_check_num_nodes(Tree* tree, int verbose);
 int tree_check_brothers(Tree* tree, int verbose);
 int tree_check_size(Tree* tree, int verbose);
+int tree_check_depth(Tree* tree, int max_depth, int verbose);
+int tree_check_codes(Tree* tree, int verbose);
+int tree_check_decode(Tree* tree, int verbose);
+int tree_check_snapshot(Tree* tree, const char* text, int verbose);
 
 #endif // TEST_TREE_H
\ No newline at end of file